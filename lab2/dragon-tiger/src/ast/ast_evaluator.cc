@@ -1,73 +1,489 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
 #include "ast_evaluator.hh"
 #include "../utils/errors.hh"
 
 namespace ast {
 
+namespace {
+
+// Thrown by break and caught by the innermost enclosing loop.
+struct BreakException {};
+
+typedef enum {
+  p_print,
+  p_print_err,
+  p_print_int,
+  p_flush,
+  p_getchar,
+  p_ord,
+  p_chr,
+  p_size,
+  p_substring,
+  p_concat,
+  p_strcmp,
+  p_streq,
+  p_not,
+  p_exit
+} Primitive;
+
+struct PrimitiveInfo {
+  Primitive primitive;
+  std::vector<Type> params;
+  Type result;
+};
+
+const std::unordered_map<Symbol, PrimitiveInfo> &primitives() {
+  static const std::unordered_map<Symbol, PrimitiveInfo> table = {
+      {Symbol("print"), {p_print, {t_string}, t_void}},
+      {Symbol("print_err"), {p_print_err, {t_string}, t_void}},
+      {Symbol("print_int"), {p_print_int, {t_int}, t_void}},
+      {Symbol("flush"), {p_flush, {}, t_void}},
+      {Symbol("getchar"), {p_getchar, {}, t_string}},
+      {Symbol("ord"), {p_ord, {t_string}, t_int}},
+      {Symbol("chr"), {p_chr, {t_int}, t_string}},
+      {Symbol("size"), {p_size, {t_string}, t_int}},
+      {Symbol("substring"), {p_substring, {t_string, t_int, t_int}, t_string}},
+      {Symbol("concat"), {p_concat, {t_string, t_string}, t_string}},
+      {Symbol("strcmp"), {p_strcmp, {t_string, t_string}, t_int}},
+      {Symbol("streq"), {p_streq, {t_string, t_string}, t_int}},
+      {Symbol("not"), {p_not, {t_int}, t_int}},
+      {Symbol("exit"), {p_exit, {t_int}, t_void}},
+  };
+  return table;
+}
+
+const std::string type_names[] = {"undefined", "int", "string", "void"};
+
+Type type_named(const location &loc, const Symbol &name) {
+  for (Type type : {t_int, t_string, t_void})
+    if (name.get() == type_names[type])
+      return type;
+  utils::error(loc, "unknown type " + name.get());
+}
+
+void check_type(const location &loc, const std::string &what, Type expected,
+                Type actual) {
+  if (expected != actual)
+    utils::error(loc, what + " must be of type " + type_names[expected] +
+                          ", not " + type_names[actual]);
+}
+
+} // namespace
+
+class ASTEvaluator::FrameGuard {
+  ASTEvaluator &evaluator;
+  Frame *const saved;
+
+public:
+  FrameGuard(ASTEvaluator &_evaluator, Frame &_frame)
+      : evaluator(_evaluator), saved(_evaluator.frame) {
+    evaluator.frame = &_frame;
+    evaluator.frames.push_back(&_frame);
+  }
+  ~FrameGuard() {
+    evaluator.frame = saved;
+    evaluator.frames.pop_back();
+  }
+};
+
+/* Finds a variable by following the static links from the current frame.
+ * The most recent declaration of a frame shadows the previous ones, and
+ * only the declarations in scope of a static link are searched. */
+ASTEvaluator::Value *ASTEvaluator::find_var(const location &loc,
+                                            const Symbol &name) {
+  size_t visible = frame->vars.size();
+  for (Frame *f = frame; f; visible = f->link_vars, f = f->static_link)
+    for (size_t i = visible; i-- > 0;)
+      if (f->vars[i].first == name)
+        return &f->vars[i].second;
+  utils::error(loc, name.get() + " cannot be found in this scope");
+}
+
+const ASTEvaluator::Closure *ASTEvaluator::find_fun(const Symbol &name) const {
+  size_t visible = frame->funs.size();
+  for (const Frame *f = frame; f; visible = f->link_funs, f = f->static_link)
+    for (size_t i = visible; i-- > 0;)
+      if (f->funs[i].first == name)
+        return &f->funs[i].second;
+  return nullptr;
+}
+
+int32_t ASTEvaluator::make_string(std::string &&s) {
+  if (free_strings.empty() && strings.size() >= collect_at)
+    collect_strings();
+  if (free_strings.empty()) {
+    strings.push_back(std::move(s));
+    return strings.size() - 1;
+  }
+  const int32_t index = free_strings.back();
+  free_strings.pop_back();
+  strings[index] = std::move(s);
+  return index;
+}
+
+/* Frees the pool entries which cannot be reached any more. A string is
+ * reachable from the variables of the frames in use, from the cache of
+ * literals, or from the operands being evaluated. Once the pool holds
+ * twice the reachable strings, the next collection happens. */
+void ASTEvaluator::collect_strings() {
+  std::vector<bool> reachable(strings.size());
+  auto mark_frame = [&](const Frame &f) {
+    for (auto &var : f.vars)
+      if (var.second.type == t_string)
+        reachable[var.second.value] = true;
+  };
+  mark_frame(globals);
+  for (auto f : frames)
+    mark_frame(*f);
+  for (auto &literal : literals)
+    reachable[literal.second] = true;
+  for (auto operand : operands)
+    reachable[operand] = true;
+
+  size_t live = 0;
+  free_strings.clear();
+  for (size_t i = 0; i < strings.size(); i++) {
+    if (reachable[i]) {
+      live++;
+    } else {
+      std::string().swap(strings[i]);
+      free_strings.push_back(i);
+    }
+  }
+  collect_at = std::max<size_t>(1024, 2 * live);
+}
+
+int32_t ASTEvaluator::eval(const Expr &expr, Type expected, const char *what) {
+  const int32_t value = expr.accept(*this);
+  check_type(expr.loc, what, expected, result_type);
+  return value;
+}
+
+void ASTEvaluator::print_result(std::ostream &ostream, int32_t value) const {
+  if (result_type == t_int)
+    ostream << value << "\n";
+  else if (result_type == t_string)
+    ostream << strings[value] << "\n";
+}
+
 int32_t ASTEvaluator::visit(const IntegerLiteral &literal) {
-  return(literal.value);
+  result_type = t_int;
+  return literal.value;
+}
+
+int32_t ASTEvaluator::visit(const StringLiteral &literal) {
+  result_type = t_string;
+  auto cached = literals.find(literal.value);
+  if (cached != literals.end())
+    return cached->second;
+  const int32_t index = make_string(std::string(literal.value.get()));
+  literals[literal.value] = index;
+  return index;
 }
 
 int32_t ASTEvaluator::visit(const BinaryOperator &binop) {
-  int a = binop.get_left().accept(*this);
-  int b = binop.get_right().accept(*this);
-  std::string op = operator_name[binop.op];
-  if(op == "+")
-	  return(a+b);
-  if(op == "-")
-	  return(a-b);
-  if(op == "*")
-	  return(a*b);
-  if(op == "/")
-	  return(a/b);
-  if(op == "=")
-	  return(a==b);
-  if(op == "<>")
-	  return(a!=b);
-  if(op == "<")
-	  return(a<b);
-  if(op == "<=")
-	  return(a<=b);
-  if(op == ">")
-	  return(a>b);
-  if(op == ">=")
-	  return(a>=b);
-  return(-1);
+  const int32_t a = binop.get_left().accept(*this);
+  const Type type = result_type;
+  if (type == t_string)
+    operands.push_back(a);
+  const int32_t b = binop.get_right().accept(*this);
+  if (type == t_string)
+    operands.pop_back();
+  const std::string &name = operator_name[binop.op];
+  if (type == t_void || result_type == t_void)
+    utils::error(binop.loc, "void operand for " + name);
+  check_type(binop.get_right().loc, "right operand of " + name, type,
+             result_type);
+  result_type = t_int;
+
+  if (type == t_string) {
+    const int c = strings[a].compare(strings[b]);
+    switch (binop.op) {
+    case o_eq:
+      return c == 0;
+    case o_neq:
+      return c != 0;
+    case o_lt:
+      return c < 0;
+    case o_le:
+      return c <= 0;
+    case o_gt:
+      return c > 0;
+    case o_ge:
+      return c >= 0;
+    default:
+      utils::error(binop.loc, "operator " + name + " cannot apply to strings");
+    }
+  }
+
+  // Arithmetic wraps around like in compiled programs.
+  switch (binop.op) {
+  case o_plus:
+    return uint32_t(a) + uint32_t(b);
+  case o_minus:
+    return uint32_t(a) - uint32_t(b);
+  case o_times:
+    return uint32_t(a) * uint32_t(b);
+  case o_divide:
+    if (b == 0)
+      utils::error(binop.loc, "division by zero");
+    return b == -1 ? -uint32_t(a) : a / b;
+  case o_eq:
+    return a == b;
+  case o_neq:
+    return a != b;
+  case o_lt:
+    return a < b;
+  case o_le:
+    return a <= b;
+  case o_gt:
+    return a > b;
+  case o_ge:
+    return a >= b;
+  }
+  __builtin_unreachable();
 }
 
 int32_t ASTEvaluator::visit(const Sequence &seqExpr) {
-  const auto exprs = seqExpr.get_exprs();
-  if(exprs.size() == 0)
-	  utils::error("Error: the sequence is empty");
-  for (auto expr = exprs.begin(); expr != exprs.end(); expr++) {
-	  (*expr)->accept(*this);
-  }
-  return(exprs.back()->accept(*this));
+  int32_t value = 0;
+  result_type = t_void;
+  for (auto expr : seqExpr.get_exprs())
+    value = expr->accept(*this);
+  return value;
 }
 
 int32_t ASTEvaluator::visit(const IfThenElse &ite) {
-  int cond = ite.get_condition().accept(*this);
-  if(cond == 1)
-	  return(ite.get_then_part().accept(*this));
-  else {
-      const Expr * exprs = &ite.get_else_part();
-      Sequence * seq = (Sequence *) exprs;
-      if(seq->get_exprs().size()>0)
-        return(ite.get_else_part().accept(*this));
-      else
-        utils::error("Error: Absent else");
+  if (eval(ite.get_condition(), t_int, "condition"))
+    return ite.get_then_part().accept(*this);
+  return ite.get_else_part().accept(*this);
+}
+
+int32_t ASTEvaluator::visit(const Let &let) {
+  Frame scope(frame);
+  FrameGuard guard(*this, scope);
+  // Consecutive function declarations see each other, so that they can
+  // be mutually recursive.
+  size_t group = 0;
+  for (auto decl : let.get_decls()) {
+    decl->accept(*this);
+    if (!dynamic_cast<const FunDecl *>(decl)) {
+      group = scope.funs.size();
+      continue;
     }
+    for (size_t i = group; i < scope.funs.size(); i++)
+      scope.funs[i].second.env_funs = scope.funs.size();
+  }
+  return let.get_sequence().accept(*this);
+}
+
+int32_t ASTEvaluator::visit(const Identifier &id) {
+  const Value &var = *find_var(id.loc, id.name);
+  result_type = var.type;
+  return var.value;
+}
+
+int32_t ASTEvaluator::visit(const VarDecl &decl) {
+  const int32_t value = decl.get_expr()->accept(*this);
+  if (result_type == t_void)
+    utils::error(decl.loc, "variable " + decl.name.get() + " has no value");
+  if (decl.type_name)
+    check_type(decl.loc, "variable " + decl.name.get(),
+               type_named(decl.loc, *decl.type_name), result_type);
+  frame->vars.push_back({decl.name, {value, result_type, decl.read_only}});
+  result_type = t_void;
+  return 0;
+}
+
+/* Functions capture the frame they are declared in, which becomes the
+ * static link of the frames of their calls, along with the declarations
+ * of that frame in scope: the variables declared so far, and the
+ * functions up to the end of their group (see visit(const Let &)).
+ * Since Tiger functions are not first-class values, that frame outlives
+ * every call. */
+int32_t ASTEvaluator::visit(const FunDecl &decl) {
+  frame->funs.push_back({decl.name,
+                         {&decl, frame, frame->vars.size(),
+                          frame->funs.size() + 1}});
+  result_type = t_void;
+  return 0;
+}
+
+int32_t ASTEvaluator::visit(const FunCall &call) {
+  std::vector<Value> args;
+  args.reserve(call.get_args().size());
+  const size_t pending = operands.size();
+  for (auto arg : call.get_args()) {
+    const int32_t value = arg->accept(*this);
+    args.push_back({value, result_type, false});
+    if (result_type == t_string)
+      operands.push_back(value);
+  }
+  // From here on, the arguments are held by the frame of the callee, or
+  // only read by a primitive before it makes its own string.
+  operands.resize(pending);
+
+  const Closure *closure = find_fun(call.func_name);
+  if (!closure)
+    return call_primitive(call, args);
+
+  const FunDecl &decl = *closure->decl;
+  const std::vector<VarDecl *> &params = decl.get_params();
+  if (params.size() != args.size())
+    utils::error(call.loc, "wrong number of arguments to " +
+                               call.func_name.get());
+  Frame callee(*closure);
+  for (size_t i = 0; i < params.size(); i++) {
+    const VarDecl &param = *params[i];
+    check_type(call.get_args()[i]->loc, "parameter " + param.name.get(),
+               type_named(param.loc, *param.type_name), args[i].type);
+    callee.vars.push_back({param.name, args[i]});
+  }
+
+  FrameGuard guard(*this, callee);
+  // A break cannot leave the function body.
+  const unsigned saved_loop_depth = loop_depth;
+  loop_depth = 0;
+  const int32_t result = decl.get_expr()->accept(*this);
+  loop_depth = saved_loop_depth;
+
+  if (!decl.type_name) {
+    result_type = t_void;
+    return 0;
+  }
+  check_type(decl.loc, "result of " + decl.name.get(),
+             type_named(decl.loc, *decl.type_name), result_type);
+  return result;
 }
 
-int32_t ASTEvaluator::visit(const StringLiteral &) {utils::error("Node not implemented yet");}
-int32_t ASTEvaluator::visit(const Let &) {utils::error("Node not implemented yet");}
-int32_t ASTEvaluator::visit(const Identifier &) {utils::error("Node not implemented yet");}
-int32_t ASTEvaluator::visit(const VarDecl &) {utils::error("Node not implemented yet");}
-int32_t ASTEvaluator::visit(const FunDecl &) {utils::error("Node not implemented yet");}
-int32_t ASTEvaluator::visit(const FunCall &) {utils::error("Node not implemented yet");}
-int32_t ASTEvaluator::visit(const WhileLoop &) {utils::error("Node not implemented yet");}
-int32_t ASTEvaluator::visit(const ForLoop &) {utils::error("Node not implemented yet");}
-int32_t ASTEvaluator::visit(const Break &) {utils::error("Node not implemented yet");}
-int32_t ASTEvaluator::visit(const Assign &) {utils::error("Node not implemented yet");}
+int32_t ASTEvaluator::call_primitive(const FunCall &call,
+                                     const std::vector<Value> &args) {
+  const std::string &name = call.func_name.get();
+  auto entry = primitives().find(call.func_name);
+  if (entry == primitives().end())
+    utils::error(call.loc, name + " cannot be found in this scope");
 
+  const PrimitiveInfo &info = entry->second;
+  if (args.size() != info.params.size())
+    utils::error(call.loc, "wrong number of arguments to " + name);
+  for (size_t i = 0; i < args.size(); i++)
+    check_type(call.get_args()[i]->loc, "argument of " + name,
+               info.params[i], args[i].type);
+  result_type = info.result;
+
+  auto str = [&](int i) -> const std::string & {
+    return strings[args[i].value];
+  };
+  switch (info.primitive) {
+  case p_print:
+    std::cout << str(0);
+    return 0;
+  case p_print_err:
+    std::cout.flush();
+    std::cerr << str(0);
+    return 0;
+  case p_print_int:
+    std::cout << args[0].value;
+    return 0;
+  case p_flush:
+    std::cout.flush();
+    return 0;
+  case p_getchar: {
+    const int c = std::cin.get();
+    return make_string(c == EOF ? std::string() : std::string(1, char(c)));
+  }
+  case p_ord:
+    return str(0).empty() ? -1 : (unsigned char)str(0)[0];
+  case p_chr: {
+    const int32_t c = args[0].value;
+    if (c < 0 || c > 255)
+      utils::error(call.loc, "ASCII character must be between 0 and 255");
+    return make_string(c ? std::string(1, char(c)) : std::string());
+  }
+  case p_size:
+    return str(0).size();
+  case p_substring: {
+    const int32_t size = str(0).size();
+    const int32_t first = args[1].value, length = args[2].value;
+    if (length < 0 || first < 0 || first > size - length)
+      utils::error(call.loc, "Impossible to get a substring: index out of "
+                             "bounds or negative parameter");
+    return make_string(str(0).substr(first, length));
+  }
+  case p_concat:
+    return make_string(str(0) + str(1));
+  case p_strcmp: {
+    const int c = str(0).compare(str(1));
+    return c < 0 ? -1 : c > 0;
+  }
+  case p_streq:
+    return str(0) == str(1);
+  case p_not:
+    return !args[0].value;
+  case p_exit:
+    std::cout.flush();
+    exit(args[0].value);
+  }
+  __builtin_unreachable();
+}
+
+int32_t ASTEvaluator::visit(const WhileLoop &loop) {
+  const size_t pending = operands.size();
+  loop_depth++;
+  try {
+    while (eval(loop.get_condition(), t_int, "loop condition"))
+      loop.get_body().accept(*this);
+  } catch (BreakException &) {
+    operands.resize(pending);
+  }
+  loop_depth--;
+  result_type = t_void;
+  return 0;
+}
+
+int32_t ASTEvaluator::visit(const ForLoop &loop) {
+  const VarDecl &variable = loop.get_variable();
+  const int32_t low = eval(*variable.get_expr(), t_int, "lower bound");
+  const int32_t high = eval(loop.get_high(), t_int, "upper bound");
+
+  Frame scope(frame);
+  scope.vars.push_back({variable.name, {low, t_int, true}});
+  FrameGuard guard(*this, scope);
+  const size_t pending = operands.size();
+  loop_depth++;
+  try {
+    // Count in 64 bits so that a high bound of INT32_MAX terminates.
+    for (int64_t i = low; i <= high; i++) {
+      scope.vars.front().second.value = i;
+      loop.get_body().accept(*this);
+    }
+  } catch (BreakException &) {
+    operands.resize(pending);
+  }
+  loop_depth--;
+  result_type = t_void;
+  return 0;
+}
+
+int32_t ASTEvaluator::visit(const Break &b) {
+  if (!loop_depth)
+    utils::error(b.loc, "break outside of a loop");
+  throw BreakException();
+}
+
+int32_t ASTEvaluator::visit(const Assign &assign) {
+  const Identifier &lhs = assign.get_lhs();
+  const int32_t value = assign.get_rhs().accept(*this);
+  Value &var = *find_var(lhs.loc, lhs.name);
+  if (var.read_only)
+    utils::error(assign.loc, "variable " + lhs.name.get() + " is read-only");
+  check_type(assign.get_rhs().loc, "value assigned to " + lhs.name.get(),
+             var.type, result_type);
+  var.value = value;
+  result_type = t_void;
+  return 0;
+}
 
 } // namespace ast
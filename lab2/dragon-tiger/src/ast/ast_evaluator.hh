@@ -1,17 +1,97 @@
 #ifndef AST_EVALUATOR_HH
 #define AST_EVALUATOR_HH
 
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "nodes.hh"
 
 namespace ast {
 
+// ASTEvaluator interprets a parsed program directly on the AST.
+//
+// Every expression evaluates to an int32_t. Strings are represented by
+// an index into the evaluator string pool, and the dynamic type of the
+// last value is kept in result_type since no type checking took place.
+// When the pool fills up, the entries which no variable, literal or
+// pending operand refers to any more are reused.
+//
+// Names are resolved at runtime: each Let body and each function call
+// runs in a Frame whose static link points to the frame the enclosing
+// declarations live in, so that nested functions see the variables of
+// their parents. A frame only sees the declarations its static link
+// held when it was created, so that declarations which come later in
+// the text do not shadow the ones in scope.
 class ASTEvaluator : public ConstASTIntVisitor {
-  std::ostream *ostream;
-  bool verbose;
-  unsigned indent_level = 0;
- 
+  struct Value {
+    int32_t value;
+    Type type;
+    bool read_only;
+  };
+
+  struct Frame;
+
+  // A function, with the frame it was declared in and the number of
+  // declarations of that frame visible from its body.
+  struct Closure {
+    const FunDecl *decl;
+    Frame *env;
+    size_t env_vars;
+    size_t env_funs;
+  };
+
+  struct Frame {
+    Frame *static_link;
+    // Number of variables and functions of the static link in scope.
+    size_t link_vars;
+    size_t link_funs;
+    std::vector<std::pair<Symbol, Value>> vars;
+    std::vector<std::pair<Symbol, Closure>> funs;
+    // A frame nested in the current code of another one.
+    explicit Frame(Frame *_static_link)
+        : static_link(_static_link),
+          link_vars(_static_link ? _static_link->vars.size() : 0),
+          link_funs(_static_link ? _static_link->funs.size() : 0) {}
+    // The frame of a call to a function.
+    explicit Frame(const Closure &closure)
+        : static_link(closure.env), link_vars(closure.env_vars),
+          link_funs(closure.env_funs) {}
+  };
+
+  // Installs a new current frame for the lifetime of the object.
+  class FrameGuard;
+
+  Frame globals = Frame(nullptr);
+  Frame *frame = &globals;
+  // The frames installed by a FrameGuard, innermost last.
+  std::vector<const Frame *> frames;
+  Type result_type = t_void;
+  unsigned loop_depth = 0;
+
+  std::vector<std::string> strings;
+  std::unordered_map<Symbol, int32_t> literals;
+  // Strings evaluated and not stored yet, such as the left operand of
+  // a comparison or the first arguments of a call.
+  std::vector<int32_t> operands;
+  // Pool entries which can be reused, and the pool size from which the
+  // next make_string looks for them.
+  std::vector<int32_t> free_strings;
+  size_t collect_at = 1024;
+
+  Value *find_var(const location &, const Symbol &);
+  const Closure *find_fun(const Symbol &) const;
+  int32_t make_string(std::string &&);
+  void collect_strings();
+  int32_t eval(const Expr &, Type expected, const char *what);
+  int32_t call_primitive(const FunCall &, const std::vector<Value> &);
+
 public:
   ASTEvaluator() {}
+  // Print a value of the type of the last evaluated expression.
+  void print_result(std::ostream &, int32_t value) const;
   virtual int32_t visit(const IntegerLiteral &);
   virtual int32_t visit(const BinaryOperator &);
   virtual int32_t visit(const Sequence &);
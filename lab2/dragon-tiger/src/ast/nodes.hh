@@ -112,6 +112,15 @@ public:
   Node &operator=(const Node &) = delete;
   Node(const Node &) = delete;
 
+  // Nodes are allocated in a utils::Arena which owns them, including
+  // their children. Deleting a node only runs its destructor.
+  static void *operator new(std::size_t) = delete;
+  static void operator delete(void *) {}
+
+  // Whether the arena must run the destructor of this node when it
+  // is released.
+  static const bool owns_memory = false;
+
   // Setter and getters for field `type'
   void set_type(Type _type) {
     assert(type == t_undef && _type != t_undef);
@@ -199,12 +208,6 @@ public:
                  const Operator &_op)
       : Expr(_loc), left(_left), right(_right), op(_op) {}
 
-  // Destructor
-  virtual ~BinaryOperator() {
-    delete right;
-    delete left;
-  }
-
   // Getters for field `left'
   Expr &get_left() { return *left; }
   const Expr &get_left() const { return *left; }
@@ -227,16 +230,13 @@ class Sequence : public Expr {
   std::vector<Expr *> exprs;
 
 public:
+  // The containers of this node must be freed with it
+  static const bool owns_memory = true;
+
   // Constructor
   Sequence(const location &_loc, const std::vector<Expr *> &_exprs)
       : Expr(_loc), exprs(_exprs) {}
 
-  // Destructor
-  virtual ~Sequence() {
-    for (auto expr : exprs)
-      delete expr;
-  }
-
   // Getters for field `exprs'
   std::vector<Expr *> &get_exprs() { return exprs; }
   const std::vector<Expr *> &get_exprs() const { return exprs; }
@@ -256,18 +256,14 @@ class Let : public Expr {
   Sequence *sequence;
 
 public:
+  // The containers of this node must be freed with it
+  static const bool owns_memory = true;
+
   // Constructor
   Let(const location &_loc, const std::vector<Decl *> &_decls,
       Sequence *_sequence)
       : Expr(_loc), decls(_decls), sequence(_sequence) {}
 
-  // Destructor
-  virtual ~Let() {
-    delete sequence;
-    for (auto decl : decls)
-      delete decl;
-  }
-
   // Getters for field `decls'
   std::vector<Decl *> &get_decls() { return decls; }
   const std::vector<Decl *> &get_decls() const { return decls; }
@@ -344,13 +340,6 @@ public:
       : Expr(_loc), condition(_condition), then_part(_then_part),
         else_part(_else_part) {}
 
-  // Destructor
-  virtual ~IfThenElse() {
-    delete else_part;
-    delete then_part;
-    delete condition;
-  }
-
   // Getters for field `condition'
   Expr &get_condition() { return *condition; }
   const Expr &get_condition() const { return *condition; }
@@ -388,9 +377,6 @@ public:
       : Decl(_loc, _name), expr(_expr), type_name(_type_name),
         read_only(_read_only) {}
 
-  // Destructor
-  virtual ~VarDecl() { delete expr; }
-
   // Getters for field `expr'
   optional<Expr &> get_expr() {
     if (!expr)
@@ -426,6 +412,9 @@ class FunDecl : public Decl {
   std::vector<VarDecl *> escaping_decls = std::vector<VarDecl *>();
 
 public:
+  // The containers of this node must be freed with it
+  static const bool owns_memory = true;
+
   // Public fields
   const optional<Symbol> type_name;
   const bool is_external;
@@ -437,13 +426,6 @@ public:
       : Decl(_loc, _name), params(_params), expr(_expr), type_name(_type_name),
         is_external(_is_external) {}
 
-  // Destructor
-  virtual ~FunDecl() {
-    delete expr;
-    for (auto param : params)
-      delete param;
-  }
-
   // Getters for field `params'
   std::vector<VarDecl *> &get_params() { return params; }
   const std::vector<VarDecl *> &get_params() const { return params; }
@@ -506,6 +488,9 @@ class FunCall : public Expr {
   int depth = -1;
 
 public:
+  // The containers of this node must be freed with it
+  static const bool owns_memory = true;
+
   // Public fields
   const Symbol func_name;
 
@@ -514,12 +499,6 @@ public:
           const Symbol &_func_name)
       : Expr(_loc), args(_args), func_name(_func_name) {}
 
-  // Destructor
-  virtual ~FunCall() {
-    for (auto arg : args)
-      delete arg;
-  }
-
   // Getters for field `args'
   std::vector<Expr *> &get_args() { return args; }
   const std::vector<Expr *> &get_args() const { return args; }
@@ -573,12 +552,6 @@ public:
   WhileLoop(const location &_loc, Expr *_condition, Expr *_body)
       : Loop(_loc), condition(_condition), body(_body) {}
 
-  // Destructor
-  virtual ~WhileLoop() {
-    delete body;
-    delete condition;
-  }
-
   // Getters for field `condition'
   Expr &get_condition() { return *condition; }
   const Expr &get_condition() const { return *condition; }
@@ -607,13 +580,6 @@ public:
   ForLoop(const location &_loc, VarDecl *_variable, Expr *_high, Expr *_body)
       : Loop(_loc), variable(_variable), high(_high), body(_body) {}
 
-  // Destructor
-  virtual ~ForLoop() {
-    delete body;
-    delete high;
-    delete variable;
-  }
-
   // Getters for field `variable'
   VarDecl &get_variable() { return *variable; }
   const VarDecl &get_variable() const { return *variable; }
@@ -678,12 +644,6 @@ public:
   Assign(const location &_loc, Identifier *_lhs, Expr *_rhs)
       : Expr(_loc), lhs(_lhs), rhs(_rhs) {}
 
-  // Destructor
-  virtual ~Assign() {
-    delete rhs;
-    delete lhs;
-  }
-
   // Getters for field `lhs'
   Identifier &get_lhs() { return *lhs; }
   const Identifier &get_lhs() const { return *lhs; }
@@ -39,7 +39,7 @@ int main(int argc, char **argv) {
     utils::error("usage: dtiger [options] input-file");
   }
 
-  ParserDriver parser_driver = ParserDriver(vm.count("trace-lexer"), vm.count("trace-parser"));
+  ParserDriver parser_driver(vm.count("trace-lexer"), vm.count("trace-parser"));
 
   if (!parser_driver.parse(input_files[0])) {
     utils::error("parser failed");
@@ -53,8 +53,8 @@ int main(int argc, char **argv) {
 
   if (vm.count("eval")) {
     ast::ASTEvaluator eval;
-    std::cout << parser_driver.result_ast->accept(eval) << "\n";
+    const int32_t value = parser_driver.result_ast->accept(eval);
+    eval.print_result(std::cout, value);
   }
-  delete parser_driver.result_ast;
   return 0;
 }
@@ -1,5 +1,6 @@
 #include "../ast/nodes.hh"
 #include "tiger_parser.hh"
+#include "../utils/arena.hh"
 #include <string>
 
 // Tell Flex the lexer's prototype ...
@@ -21,6 +22,10 @@ public:
   bool trace_lexer;
   bool trace_parser;
 
+  // The arena holding every node of the AST. It is released, together
+  // with the AST, when the driver is destroyed.
+  utils::Arena arena;
+
   // The parser produced AST
   Expr *result_ast;
 
@@ -3,7 +3,12 @@
 #include <cerrno>
 #include <climits>
 #include <cstdlib>
+#include <cstring>
 #include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "parser_driver.hh"
 #include "tiger_parser.hh"
 #include "../utils/errors.hh"
@@ -88,7 +93,7 @@ if	 return yy::tiger_parser::make_IF(loc);
 then     return yy::tiger_parser::make_THEN(loc);
 else     return yy::tiger_parser::make_ELSE(loc);
  /* Identifiers */
-{id}       return yy::tiger_parser::make_ID(Symbol(yytext), loc);
+{id}       return yy::tiger_parser::make_ID(Symbol(yytext, yyleng), loc);
 
  /* Integers */
 {integer} {
@@ -103,6 +108,12 @@ else     return yy::tiger_parser::make_ELSE(loc);
 }
 
  /* Strings */
+
+ /* A string without escapes is interned directly from the input buffer */
+\"[^"\\\r\n]*\" {
+    return yy::tiger_parser::make_STRING(Symbol(yytext + 1, yyleng - 2), loc);
+}
+
 \" {BEGIN(STRING); string_buffer.clear();}
 
 <STRING>{
@@ -130,7 +141,7 @@ else     return yy::tiger_parser::make_ELSE(loc);
     "\\" utils::error (loc, "unescaping backslash");
 
     /* All other characters are accepted */
-    . {string_buffer.push_back(yytext[0]);}
+    [^"\\\r\n]+ {string_buffer.append(yytext, yyleng);}
 }
 
  /* Comments */
@@ -154,16 +165,58 @@ else     return yy::tiger_parser::make_ELSE(loc);
 
 %%
 
+// Regular files are mapped in memory and scanned in place. Flex needs
+// two NUL bytes after the input and temporarily writes into the buffer
+// while scanning, so the file is mapped privately on top of a
+// zero-filled anonymous region two bytes larger than the file.
+static char *mapped_input = nullptr;
+static size_t mapped_size = 0;
+static YY_BUFFER_STATE mapped_buffer = nullptr;
+
+static bool map_input (const std::string &file)
+{
+  int fd = open (file.c_str (), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat (fd, &st) < 0)
+    utils::error("cannot open " + file + ": " + strerror(errno));
+  if (!S_ISREG (st.st_mode)) {
+    close (fd);
+    return false;
+  }
+
+  const size_t size = st.st_size;
+  void *region = mmap (nullptr, size + 2, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED ||
+      (size > 0 && mmap (region, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED))
+    utils::error("cannot map " + file + ": " + strerror(errno));
+  close (fd);
+
+  mapped_input = static_cast<char *> (region);
+  mapped_size = size + 2;
+  mapped_buffer = yy_scan_buffer (mapped_input, mapped_size);
+  return true;
+}
+
 void ParserDriver::lex_begin ()
 {
   yy_flex_debug = trace_lexer;
   if (file.empty () || file == "-")
     yyin = stdin;
+  else if (map_input (file))
+    return;
   else if (!(yyin = fopen (file.c_str (), "r")))
     utils::error("cannot open " + file + ": " + strerror(errno));
 }
 
 void ParserDriver::lex_end ()
 {
-  fclose (yyin);
+  if (mapped_input) {
+    yy_delete_buffer (mapped_buffer);
+    munmap (mapped_input, mapped_size);
+    mapped_input = nullptr;
+    mapped_buffer = nullptr;
+  } else
+    fclose (yyin);
 }
@@ -127,8 +127,11 @@ decl: varDecl { $$ = $1; }
    | funcDecl { $$ = $1; }
 ;
 
-if_stmt: IF expr THEN expr ELSE expr {$$ = new IfThenElse(@2, $2, $4, $6); } 
-       | IF expr THEN expr {$$ = new IfThenElse(@2, $2, $4, new Sequence(nl, std::vector<Expr *>()));}
+if_stmt: IF expr THEN expr ELSE expr {$$ = driver.arena.make<IfThenElse>(@2, $2, $4, $6); } 
+       | IF expr THEN expr {
+         $$ = driver.arena.make<IfThenElse>(@2, $2, $4,
+                                            driver.arena.make<Sequence>(nl, std::vector<Expr *>()));
+       }
 ;
 
 expr: stringExpr { $$ = $1; }
@@ -147,78 +150,87 @@ expr: stringExpr { $$ = $1; }
 ;
 
 varDecl: VAR ID typeannotation ASSIGN expr
-  { $$ = new VarDecl(@1, $2, $5, $3); }
+  { $$ = driver.arena.make<VarDecl>(@1, $2, $5, $3); }
 ;
 
 funcDecl: FUNCTION ID LPAREN params RPAREN typeannotation EQ expr
-  { $$ = new FunDecl(@1, $2, $4, $8, $6); }
+  { $$ = driver.arena.make<FunDecl>(@1, $2, $4, $8, $6); }
 ;
 
 /* Exprs */
 
 stringExpr: STRING
-  { $$ = new StringLiteral(@1, Symbol($1)); }
+  { $$ = driver.arena.make<StringLiteral>(@1, Symbol($1)); }
 ;
 
 intExpr: INT
-  { $$ = new IntegerLiteral(@1, $1); }
+  { $$ = driver.arena.make<IntegerLiteral>(@1, $1); }
 ;
 
 var : ID
-  { $$ = new Identifier(@1, $1); }
+  { $$ = driver.arena.make<Identifier>(@1, $1); }
 ;
 
 callExpr: ID LPAREN arguments RPAREN
-  { $$ = new FunCall(@1, $3, Symbol($1)); }
+  { $$ = driver.arena.make<FunCall>(@1, $3, Symbol($1)); }
 ;
 
 negExpr: MINUS expr
-  { $$ = new BinaryOperator(@1, new IntegerLiteral(@1, 0), $2, o_minus); }
+  { $$ = driver.arena.make<BinaryOperator>(@1, driver.arena.make<IntegerLiteral>(@1, 0), $2, o_minus); }
   %prec UMINUS
 ;
 
 /*opExp: expr op expr*/
 
-opExpr: expr PLUS expr   { $$ = new BinaryOperator(@2, $1, $3, o_plus); }
-      | expr MINUS expr  { $$ = new BinaryOperator(@2, $1, $3, o_minus); }
-      | expr TIMES expr  { $$ = new BinaryOperator(@2, $1, $3, o_times); }
-      | expr DIVIDE expr { $$ = new BinaryOperator(@2, $1, $3, o_divide); }
-      | expr EQ expr     { $$ = new BinaryOperator(@2, $1, $3, o_eq); }
-      | expr NEQ expr    { $$ = new BinaryOperator(@2, $1, $3, o_neq); }
-      | expr LT expr     { $$ = new BinaryOperator(@2, $1, $3, o_lt); }
-      | expr GT expr     { $$ = new BinaryOperator(@2, $1, $3, o_gt); }
-      | expr LE expr     { $$ = new BinaryOperator(@2, $1, $3, o_le); }
-      | expr GE expr     { $$ = new BinaryOperator(@2, $1, $3, o_ge); }
+opExpr: expr PLUS expr   { $$ = driver.arena.make<BinaryOperator>(@2, $1, $3, o_plus); }
+      | expr MINUS expr  { $$ = driver.arena.make<BinaryOperator>(@2, $1, $3, o_minus); }
+      | expr TIMES expr  { $$ = driver.arena.make<BinaryOperator>(@2, $1, $3, o_times); }
+      | expr DIVIDE expr { $$ = driver.arena.make<BinaryOperator>(@2, $1, $3, o_divide); }
+      | expr EQ expr     { $$ = driver.arena.make<BinaryOperator>(@2, $1, $3, o_eq); }
+      | expr NEQ expr    { $$ = driver.arena.make<BinaryOperator>(@2, $1, $3, o_neq); }
+      | expr LT expr     { $$ = driver.arena.make<BinaryOperator>(@2, $1, $3, o_lt); }
+      | expr GT expr     { $$ = driver.arena.make<BinaryOperator>(@2, $1, $3, o_gt); }
+      | expr LE expr     { $$ = driver.arena.make<BinaryOperator>(@2, $1, $3, o_le); }
+      | expr GE expr     { $$ = driver.arena.make<BinaryOperator>(@2, $1, $3, o_ge); }
       | expr AND expr    {
-        $$ = new IfThenElse(@2, $1,
-                            new IfThenElse(@3, $3, new IntegerLiteral(nl, 1), new IntegerLiteral(nl, 0)),
-                            new IntegerLiteral(nl, 0));
+        $$ = driver.arena.make<IfThenElse>(@2, $1,
+                            driver.arena.make<IfThenElse>(@3, $3,
+                                                          driver.arena.make<IntegerLiteral>(nl, 1),
+                                                          driver.arena.make<IntegerLiteral>(nl, 0)),
+                            driver.arena.make<IntegerLiteral>(nl, 0));
       }
       | expr OR expr    {
-        $$ = new IfThenElse(@2, $1 , new IntegerLiteral(nl, 1), new IfThenElse(@3, $3, new IntegerLiteral(nl, 1), new IntegerLiteral(nl, 0)));
+        $$ = driver.arena.make<IfThenElse>(@2, $1,
+                            driver.arena.make<IntegerLiteral>(nl, 1),
+                            driver.arena.make<IfThenElse>(@3, $3,
+                                                          driver.arena.make<IntegerLiteral>(nl, 1),
+                                                          driver.arena.make<IntegerLiteral>(nl, 0)));
 	}
 ;
 
 
 assignExpr: ID ASSIGN expr
-  { $$ = new Assign(@2, new Identifier(@1, $1), $3); }
+  { $$ = driver.arena.make<Assign>(@2, driver.arena.make<Identifier>(@1, $1), $3); }
 ;
 
-whileExpr: WHILE expr DO expr { $$ = new WhileLoop(@1, $2, $4); }
+whileExpr: WHILE expr DO expr { $$ = driver.arena.make<WhileLoop>(@1, $2, $4); }
 ;
 
 forExpr: FOR ID ASSIGN expr TO expr DO expr
-  { $$ = new ForLoop(@1, new VarDecl(@2, $2, $4, boost::none, true), $6, $8); }
+  {
+    $$ = driver.arena.make<ForLoop>(@1, driver.arena.make<VarDecl>(@2, $2, $4, boost::none, true),
+                                    $6, $8);
+  }
 ;
 
-breakExpr: BREAK { $$ = new Break(@1); }
+breakExpr: BREAK { $$ = driver.arena.make<Break>(@1); }
 ;
 
 letExpr: LET decls IN exprs END
-  { $$ = new Let(@1, $2, new Sequence(nl, $4)); }
+  { $$ = driver.arena.make<Let>(@1, $2, driver.arena.make<Sequence>(nl, $4)); }
 ;
 
-seqExpr : LPAREN exprs RPAREN { $$ = new Sequence(@1, $2); }
+seqExpr : LPAREN exprs RPAREN { $$ = driver.arena.make<Sequence>(@1, $2); }
 ;
 
 exprs: { $$ = std::vector<Expr *>(); }
@@ -265,7 +277,7 @@ decls: { $$ = std::vector<Decl *>();}
   }
 ;
 
-param: ID COLON ID { $$ = new VarDecl(@1, $1, nullptr, $3); }
+param: ID COLON ID { $$ = driver.arena.make<VarDecl>(@1, $1, nullptr, $3); }
 ;
 
 typeannotation: { $$ = boost::none; }
@@ -0,0 +1,40 @@
+#include <cstdlib>
+
+#include "arena.hh"
+
+namespace {
+
+// Size of the chunks requested from the system. Larger objects get
+// a chunk of their own.
+const std::size_t chunk_size = 64 * 1024;
+
+} // namespace
+
+namespace utils {
+
+void *Arena::allocate_slow(std::size_t size) {
+  const std::size_t length = size > chunk_size ? size : chunk_size;
+  char *const chunk = static_cast<char *>(std::malloc(length));
+  if (!chunk)
+    throw std::bad_alloc();
+  chunks.push_back(chunk);
+  // Keep bumping into the current chunk if the new one was only
+  // created for a large object.
+  if (length == chunk_size) {
+    next = chunk + size;
+    end = chunk + length;
+  }
+  return chunk;
+}
+
+void Arena::release() {
+  for (auto &finalizer : finalizers)
+    finalizer.destroy(finalizer.object);
+  finalizers.clear();
+  for (auto chunk : chunks)
+    std::free(chunk);
+  chunks.clear();
+  next = end = nullptr;
+}
+
+} // namespace utils
@@ -0,0 +1,71 @@
+#ifndef ARENA_HH
+#define ARENA_HH
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace utils {
+
+// Arena is a bump allocator owning every object allocated through
+// make(). Objects are never freed individually: all the memory is given
+// back at once when the arena is released or destroyed.
+//
+// Destructors are not run on release, except for the types which set
+// T::owns_memory to true (for example because they hold a std::vector).
+// Those are recorded when they are created and destroyed in a flat
+// loop, without any recursion.
+
+class Arena {
+  struct Finalizer {
+    void (*destroy)(void *);
+    void *object;
+  };
+
+  std::vector<char *> chunks;
+  char *next = nullptr;
+  char *end = nullptr;
+  std::vector<Finalizer> finalizers;
+
+  void *allocate_slow(std::size_t size);
+
+  template <typename T> static void destroy(void *object) {
+    static_cast<T *>(object)->~T();
+  }
+
+public:
+  Arena() {}
+  ~Arena() { release(); }
+
+  // Delete copy operator and constructor
+  Arena &operator=(const Arena &) = delete;
+  Arena(const Arena &) = delete;
+
+  // Allocate uninitialized memory suitably aligned for any object.
+  void *allocate(std::size_t size) {
+    size = (size + alignof(std::max_align_t) - 1) &
+           ~(alignof(std::max_align_t) - 1);
+    if (size > static_cast<std::size_t>(end - next))
+      return allocate_slow(size);
+    void *const result = next;
+    next += size;
+    return result;
+  }
+
+  // Build a new object of type T into the arena.
+  template <typename T, typename... Args> T *make(Args &&... args) {
+    T *const object = ::new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    if (T::owns_memory)
+      finalizers.push_back({&destroy<T>, object});
+    return object;
+  }
+
+  // Give back all the memory held by the arena. Every object
+  // allocated in it becomes invalid.
+  void release();
+};
+
+} // namespace utils
+
+#endif // ARENA_HH
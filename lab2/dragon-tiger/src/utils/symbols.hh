@@ -1,6 +1,7 @@
 #ifndef SYMBOLS_HH
 #define SYMBOLS_HH
 
+#include <cstddef>
 #include <ostream>
 #include <string>
 
@@ -11,24 +12,39 @@ namespace utils {
 // memory, and comparaison is fast since it boils down to comparing two
 // pointers.
 //
-// This implementation is not thread-safe, but the dragon-tiger compiler
-// is single-threaded.
+// Interning is thread-safe. The table is split into shards, each one
+// with its own lock, so that threads creating symbols concurrently
+// rarely wait for each other. The hash of an interned string is
+// computed once and kept next to it, so hashing a Symbol is free.
 
 class Symbol {
-  const std::string *str;
+public:
+  // An interned string.
+  struct Entry {
+    const std::string str;
+    const size_t hash;
+  };
+
+private:
+  const Entry *entry;
+  static const Entry *intern(const char *s, size_t length);
 
 public:
-  Symbol() : str(nullptr) {}
-  Symbol(std::string const &);
-  Symbol(Symbol const &s) : str(s.str) {}
-  size_t hash() const noexcept { return std::hash<std::string>()(*str); }
-  std::string const &get() const { return *str; }
-  operator std::string() const { return *str; }
-  bool operator==(Symbol const &other) const { return str == other.str; }
-  bool operator!=(Symbol const &other) const { return str != other.str; }
+  Symbol() : entry(nullptr) {}
+  Symbol(std::string const &s);
+  Symbol(const char *s, size_t length) : entry(intern(s, length)) {}
+  Symbol(Symbol const &s) : entry(s.entry) {}
+  size_t hash() const noexcept { return entry->hash; }
+  std::string const &get() const { return entry->str; }
+  operator std::string() const { return entry->str; }
+  bool operator==(Symbol const &other) const { return entry == other.entry; }
+  bool operator!=(Symbol const &other) const { return entry != other.entry; }
   friend std::ostream &operator<<(std::ostream &o, Symbol const &s) {
-    return o << (s.str ? *s.str : "<null>");
+    return o << (s.entry ? s.entry->str : "<null>");
   }
+
+  // Number of distinct strings interned so far.
+  static size_t table_size();
 };
 
 } // namespace utils
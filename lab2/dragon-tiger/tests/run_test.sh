@@ -0,0 +1,8 @@
+#! /bin/sh
+#
+# Evaluate a Tiger program with dtiger and compare its output with the
+# .expected file next to it.
+
+test $# -eq 1 || { echo "usage: $0 program.tig" >&2; exit 99; }
+expected="${1%.tig}.expected"
+"${DTIGER:-dtiger}" --eval "$1" | diff -u "$expected" -
@@ -57,6 +57,8 @@ Binder::Binder() : scopes() {
   enter_primitive("print_int", "void", {"int"});
   enter_primitive("flush", "void", {});
   enter_primitive("getchar", "string", {});
+  enter_primitive("getline", "string", {});
+  enter_primitive("readall", "string", {});
   enter_primitive("ord", "int", {"string"});
   enter_primitive("chr", "string", {"int"});
   enter_primitive("size", "int", {"string"});
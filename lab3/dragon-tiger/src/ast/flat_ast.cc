@@ -0,0 +1,482 @@
+#include "flat_ast.hh"
+#include "../utils/nolocation.hh"
+
+namespace ast {
+namespace flat {
+
+const char *const kind_name[] = {
+    "IntegerLiteral", "StringLiteral", "BinaryOperator", "Sequence",
+    "Let",            "Identifier",    "IfThenElse",     "VarDecl",
+    "FunDecl",        "FunCall",       "WhileLoop",      "ForLoop",
+    "Break",          "Assign"};
+
+namespace {
+
+// Fill the columns of a FlatAST by walking the pointer-linked tree
+// once. The children of a node are flattened right after it, into the
+// child slots it has reserved.
+class Flattener : public ConstASTVisitor {
+  FlatAST &flat;
+  std::vector<const Node *> &nodes;
+  // Declarations in scope and enclosing loops, with their index. The
+  // functions of a let are entered with no_node before any of them is
+  // flattened, so that calls can precede the callee.
+  std::vector<std::pair<const Node *, Index>> scope;
+  // Calls to a function not flattened yet, with its slot in scope.
+  std::vector<std::pair<Index, size_t>> forward_calls;
+
+  Index add(const Node &node, Kind kind, size_t child_count,
+            int32_t value = 0, Symbol name = Symbol()) {
+    const Index index = flat.size();
+    nodes.push_back(&node);
+    flat.kinds.push_back(kind);
+    flat.types.push_back(node.get_type());
+    flat.locations.push_back(node.loc);
+    flat.values.push_back(value);
+    flat.names.push_back(name);
+    flat.refs.push_back(no_node);
+    flat.type_names.push_back(Symbol());
+    flat.external_names.push_back(Symbol());
+    flat.escapes.push_back(false);
+    flat.first_child.push_back(static_cast<Index>(flat.children.size()));
+    flat.child_count.push_back(static_cast<uint32_t>(child_count));
+    flat.children.resize(flat.children.size() + child_count, no_node);
+    return index;
+  }
+
+  // Flatten the n-th child of parent, if present.
+  void child(Index parent, uint32_t n, const Node *node) {
+    if (!node)
+      return;
+    flat.children[flat.first_child[parent] + n] = flat.size();
+    node->accept(*this);
+  }
+
+  // Slot of node in scope, or scope.size() if it is not there.
+  size_t find(const Node *node) const {
+    for (size_t i = scope.size(); i-- > 0;)
+      if (scope[i].first == node)
+        return i;
+    return scope.size();
+  }
+
+  Index find_index(const Node *node) const {
+    const size_t slot = find(node);
+    return slot < scope.size() ? scope[slot].second : no_node;
+  }
+
+  template <typename T> static const Node *opt(const optional<T &> &o) {
+    return o ? &*o : nullptr;
+  }
+
+public:
+  Flattener(FlatAST &_flat, std::vector<const Node *> &_nodes)
+      : flat(_flat), nodes(_nodes) {}
+
+  virtual void visit(const IntegerLiteral &literal) {
+    add(literal, k_integer_literal, 0, literal.value);
+  }
+
+  virtual void visit(const StringLiteral &literal) {
+    add(literal, k_string_literal, 0, 0, literal.value);
+  }
+
+  virtual void visit(const BinaryOperator &op) {
+    const Index index = add(op, k_binary_operator, 2, op.op);
+    child(index, 0, &op.get_left());
+    child(index, 1, &op.get_right());
+  }
+
+  virtual void visit(const Sequence &seq) {
+    const auto &exprs = seq.get_exprs();
+    const Index index = add(seq, k_sequence, exprs.size());
+    for (uint32_t n = 0; n < exprs.size(); n++)
+      child(index, n, exprs[n]);
+  }
+
+  virtual void visit(const Let &let) {
+    const size_t mark = scope.size();
+    const size_t pending = forward_calls.size();
+    const auto &decls = let.get_decls();
+    for (auto decl : decls)
+      if (dynamic_cast<const FunDecl *>(decl))
+        scope.push_back({decl, no_node});
+
+    const Index index = add(let, k_let, decls.size() + 1);
+    for (uint32_t n = 0; n < decls.size(); n++)
+      child(index, n, decls[n]);
+    child(index, decls.size(), &let.get_sequence());
+
+    // Every function of this let has its index now.
+    for (size_t i = pending; i < forward_calls.size(); i++)
+      flat.refs[forward_calls[i].first] =
+          scope[forward_calls[i].second].second;
+    forward_calls.resize(pending);
+    scope.resize(mark);
+  }
+
+  virtual void visit(const Identifier &id) {
+    const Index index = add(id, k_identifier, 0, id.get_depth(), id.name);
+    flat.refs[index] = find_index(opt(id.get_decl()));
+  }
+
+  virtual void visit(const IfThenElse &ite) {
+    const Index index = add(ite, k_if_then_else, 3);
+    child(index, 0, &ite.get_condition());
+    child(index, 1, &ite.get_then_part());
+    child(index, 2, &ite.get_else_part());
+  }
+
+  virtual void visit(const VarDecl &decl) {
+    const Index index =
+        add(decl, k_var_decl, 1, decl.get_depth(), decl.name);
+    if (decl.type_name)
+      flat.type_names[index] = *decl.type_name;
+    flat.escapes[index] = decl.get_escapes();
+    child(index, 0, opt(decl.get_expr()));
+    scope.push_back({&decl, index});
+  }
+
+  virtual void visit(const FunDecl &decl) {
+    const auto &params = decl.get_params();
+    const Index index =
+        add(decl, k_fun_decl, params.size() + 1, decl.get_depth(), decl.name);
+    if (decl.type_name)
+      flat.type_names[index] = *decl.type_name;
+    flat.external_names[index] = decl.get_external_name();
+
+    const size_t slot = find(&decl);
+    if (slot < scope.size())
+      scope[slot].second = index;
+    else
+      scope.push_back({&decl, index});
+    const size_t mark = scope.size();
+    for (uint32_t n = 0; n < params.size(); n++)
+      child(index, n, params[n]);
+    child(index, params.size(), opt(decl.get_expr()));
+    scope.resize(mark);
+  }
+
+  virtual void visit(const FunCall &call) {
+    const auto &args = call.get_args();
+    const Index index = add(call, k_fun_call, args.size(), call.get_depth(),
+                            call.func_name);
+    if (auto decl = call.get_decl()) {
+      // Primitives are declared outside of the tree.
+      const size_t slot = decl->is_external ? scope.size() : find(&*decl);
+      if (slot == scope.size())
+        flat.refs[index] = outside;
+      else if (scope[slot].second == no_node)
+        forward_calls.push_back({index, slot});
+      else
+        flat.refs[index] = scope[slot].second;
+    }
+    for (uint32_t n = 0; n < args.size(); n++)
+      child(index, n, args[n]);
+  }
+
+  virtual void visit(const WhileLoop &loop) {
+    const Index index = add(loop, k_while_loop, 2);
+    scope.push_back({&loop, index});
+    child(index, 0, &loop.get_condition());
+    child(index, 1, &loop.get_body());
+    scope.pop_back();
+  }
+
+  virtual void visit(const ForLoop &loop) {
+    const size_t mark = scope.size();
+    const Index index = add(loop, k_for_loop, 3);
+    scope.push_back({&loop, index});
+    child(index, 0, &loop.get_variable());
+    child(index, 1, &loop.get_high());
+    child(index, 2, &loop.get_body());
+    scope.resize(mark);
+  }
+
+  virtual void visit(const Break &b) {
+    const Index index = add(b, k_break, 0);
+    flat.refs[index] = find_index(opt(b.get_loop()));
+  }
+
+  virtual void visit(const Assign &assign) {
+    const Index index = add(assign, k_assign, 2);
+    child(index, 0, &assign.get_lhs());
+    child(index, 1, &assign.get_rhs());
+  }
+};
+
+// Print a FlatAST as Tiger source, reading only its columns. The
+// output is the one of ASTDumper.
+class SourceDumper {
+  const FlatAST &flat;
+  std::ostream &ostream;
+  const bool verbose;
+  unsigned indent_level = 0;
+
+  void nl() {
+    ostream << std::endl;
+    for (unsigned i = 0; i < indent_level; i++)
+      ostream << "  ";
+  }
+  void inl() {
+    indent_level++;
+    nl();
+  }
+  void dnl() {
+    indent_level--;
+    nl();
+  }
+
+  void string_literal(const std::string &value) {
+    ostream << '"';
+    for (auto c : value) {
+      switch (c) {
+      case '"':
+        ostream << "\\\"";
+        break;
+      case '\\':
+        ostream << "\\\\";
+        break;
+      case '\a':
+        ostream << "\\a";
+        break;
+      case '\b':
+        ostream << "\\b";
+        break;
+      case '\t':
+        ostream << "\\t";
+        break;
+      case '\n':
+        ostream << "\\n";
+        break;
+      case '\v':
+        ostream << "\\v";
+        break;
+      case '\f':
+        ostream << "\\f";
+        break;
+      case '\r':
+        ostream << "\\r";
+        break;
+      default:
+        ostream << c;
+      }
+    }
+    ostream << '"';
+  }
+
+  // Print the expressions of a sequence, without the parentheses.
+  void expressions(Index seq) {
+    for (uint32_t n = 0; n < flat.child_count[seq]; n++) {
+      if (n)
+        ostream << ';';
+      nl();
+      dump(flat.child(seq, n));
+    }
+  }
+
+  void declaration_location(Index decl) {
+    ostream << "decl:";
+    if (decl == outside)
+      ostream << utils::nl;
+    else
+      ostream << flat.locations[decl];
+  }
+
+public:
+  SourceDumper(const FlatAST &_flat, std::ostream &_ostream, bool _verbose)
+      : flat(_flat), ostream(_ostream), verbose(_verbose) {}
+
+  void dump(Index i) {
+    const uint32_t count = flat.child_count[i];
+    switch (flat.kinds[i]) {
+    case k_integer_literal:
+      ostream << flat.values[i];
+      break;
+    case k_string_literal:
+      string_literal(flat.names[i]);
+      break;
+    case k_binary_operator:
+      ostream << '(';
+      dump(flat.child(i, 0));
+      ostream << operator_name[flat.values[i]];
+      dump(flat.child(i, 1));
+      ostream << ')';
+      break;
+    case k_sequence:
+      ostream << "(";
+      indent_level++;
+      expressions(i);
+      dnl();
+      ostream << ")";
+      break;
+    case k_let:
+      ostream << "let";
+      indent_level++;
+      for (uint32_t n = 0; n + 1 < count; n++) {
+        nl();
+        dump(flat.child(i, n));
+      }
+      dnl();
+      ostream << "in";
+      indent_level++;
+      expressions(flat.child(i, count - 1));
+      dnl();
+      ostream << "end";
+      break;
+    case k_identifier:
+      ostream << flat.names[i];
+      if (verbose && flat.refs[i] != no_node) {
+        ostream << "/*";
+        declaration_location(flat.refs[i]);
+        if (int depth_diff = flat.values[i] - flat.values[flat.refs[i]])
+          ostream << " depth_diff:" << depth_diff;
+        ostream << "*/";
+      }
+      break;
+    case k_if_then_else:
+      ostream << "if ";
+      inl();
+      dump(flat.child(i, 0));
+      dnl();
+      ostream << " then ";
+      inl();
+      dump(flat.child(i, 1));
+      dnl();
+      ostream << " else ";
+      inl();
+      dump(flat.child(i, 2));
+      indent_level--;
+      break;
+    case k_var_decl: {
+      const Index expr = flat.child(i, 0);
+      if (expr != no_node)
+        ostream << "var ";
+      ostream << flat.names[i];
+      if (verbose && flat.escapes[i])
+        ostream << "/*e*/";
+      if (flat.type_names[i] != Symbol())
+        ostream << ": " << flat.type_names[i];
+      else if (flat.types[i] == t_int)
+        ostream << ": int";
+      else if (flat.types[i] == t_string)
+        ostream << ": string";
+      if (expr != no_node) {
+        ostream << " := ";
+        dump(expr);
+      }
+      break;
+    }
+    case k_fun_decl:
+      ostream << "function " << flat.names[i];
+      if (verbose && flat.names[i] != flat.external_names[i])
+        ostream << "/*" << flat.external_names[i] << "*/";
+      ostream << '(';
+      for (uint32_t n = 0; n + 1 < count; n++) {
+        if (n)
+          ostream << ", ";
+        dump(flat.child(i, n));
+      }
+      ostream << ")";
+      if (flat.type_names[i] != Symbol())
+        ostream << ": " << flat.type_names[i];
+      ostream << " = ";
+      inl();
+      dump(flat.child(i, count - 1));
+      indent_level--;
+      break;
+    case k_fun_call:
+      ostream << flat.names[i];
+      if (verbose && flat.refs[i] != no_node) {
+        ostream << "/*";
+        declaration_location(flat.refs[i]);
+        ostream << "*/";
+      }
+      ostream << "(";
+      for (uint32_t n = 0; n < count; n++) {
+        if (n)
+          ostream << ", ";
+        dump(flat.child(i, n));
+      }
+      ostream << ')';
+      break;
+    case k_while_loop:
+      ostream << "while ";
+      dump(flat.child(i, 0));
+      ostream << " do";
+      inl();
+      dump(flat.child(i, 1));
+      indent_level--;
+      break;
+    case k_for_loop: {
+      const Index variable = flat.child(i, 0);
+      ostream << "for " << flat.names[variable];
+      if (verbose && flat.escapes[variable])
+        ostream << "/*e*/";
+      ostream << " := ";
+      dump(flat.child(variable, 0));
+      ostream << " to ";
+      dump(flat.child(i, 1));
+      ostream << " do";
+      inl();
+      dump(flat.child(i, 2));
+      indent_level--;
+      break;
+    }
+    case k_break:
+      ostream << "break";
+      if (verbose && flat.refs[i] != no_node)
+        ostream << "/*loop:" << flat.locations[flat.refs[i]] << "*/";
+      break;
+    case k_assign:
+      dump(flat.child(i, 0));
+      ostream << " := ";
+      dump(flat.child(i, 1));
+      break;
+    }
+  }
+};
+
+} // namespace
+
+FlatAST::FlatAST(const Node &root) {
+  Flattener flattener(*this, nodes);
+  root.accept(flattener);
+}
+
+void FlatAST::dump(std::ostream &ostream) const {
+  for (Index i = 0; i < size(); i++) {
+    ostream << i << ": " << kind_name[kinds[i]];
+    if (kinds[i] == k_binary_operator)
+      ostream << " " << operator_name[values[i]];
+    else if (kinds[i] == k_integer_literal)
+      ostream << " " << values[i];
+    else if (names[i] != Symbol())
+      ostream << " " << names[i];
+    if (refs[i] == outside)
+      ostream << " -> outside";
+    else if (refs[i] != no_node)
+      ostream << " -> " << refs[i];
+    if (child_count[i]) {
+      ostream << " [";
+      for (uint32_t n = 0; n < child_count[i]; n++) {
+        const Index c = child(i, n);
+        ostream << (n ? " " : "");
+        if (c == no_node)
+          ostream << "-";
+        else
+          ostream << c;
+      }
+      ostream << "]";
+    }
+    ostream << std::endl;
+  }
+}
+
+void FlatAST::dump_source(std::ostream &ostream, bool verbose) const {
+  if (size() > 0)
+    SourceDumper(*this, ostream, verbose).dump(0);
+}
+
+} // namespace flat
+} // namespace ast
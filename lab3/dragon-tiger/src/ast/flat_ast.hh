@@ -0,0 +1,105 @@
+#ifndef FLAT_AST_HH
+#define FLAT_AST_HH
+
+#include <ostream>
+
+#include "nodes.hh"
+
+namespace ast {
+namespace flat {
+
+// Index of a node in a FlatAST.
+typedef uint32_t Index;
+const Index no_node = ~0U;
+// Reference to a declaration which is not part of the tree, such as
+// a primitive.
+const Index outside = no_node - 1;
+
+typedef enum : uint8_t {
+  k_integer_literal = 0,
+  k_string_literal,
+  k_binary_operator,
+  k_sequence,
+  k_let,
+  k_identifier,
+  k_if_then_else,
+  k_var_decl,
+  k_fun_decl,
+  k_fun_call,
+  k_while_loop,
+  k_for_loop,
+  k_break,
+  k_assign
+} Kind;
+extern const char *const kind_name[];
+
+// FlatAST is an index-based, struct-of-arrays encoding of a tree of
+// Node. Nodes are numbered in pre-order, so that a pass walking the
+// columns from 0 to size() - 1 sees every parent before its children,
+// and each attribute of a node lives in its own contiguous column.
+//
+// The children of node i are children[first_child[i]] to
+// children[first_child[i] + child_count[i] - 1], in the order of the
+// corresponding Node getters. A missing optional child (such as the
+// expression of a parameter) is no_node.
+//
+// The tree is flattened in a single walk, without any map from nodes
+// to indices: a declaration is only referenced from its scope, so the
+// flattener looks references up in the stack of the declarations in
+// scope and of the enclosing loops.
+//
+// During the migration, node(i) gives back the pointer-linked node,
+// so that the existing visitors can still run on any part of the tree.
+
+class FlatAST {
+  std::vector<const Node *> nodes;
+
+public:
+  // Columns, indexed by node
+  std::vector<Kind> kinds;
+  std::vector<Type> types;
+  std::vector<location> locations;
+  std::vector<Index> first_child;
+  std::vector<uint32_t> child_count;
+  // Integer value, operator or depth, depending on the kind
+  std::vector<int32_t> values;
+  // Literal value, identifier or declaration name, if any
+  std::vector<Symbol> names;
+  // Declaration of an identifier or a call, or loop of a break
+  std::vector<Index> refs;
+  // Declared type of a variable or a function, if any
+  std::vector<Symbol> type_names;
+  // External name of a function
+  std::vector<Symbol> external_names;
+  // Whether a variable escapes
+  std::vector<uint8_t> escapes;
+
+  // Child lists, indexed through first_child
+  std::vector<Index> children;
+
+  // Build the flat representation of the tree rooted at root.
+  explicit FlatAST(const Node &root);
+
+  Index size() const { return static_cast<Index>(kinds.size()); }
+  Index child(Index node, uint32_t n) const {
+    assert(n < child_count[node]);
+    return children[first_child[node] + n];
+  }
+
+  // Adapter to the pointer-linked representation
+  const Node &node(Index i) const { return *nodes[i]; }
+  void accept(Index i, ConstASTVisitor &visitor) const {
+    nodes[i]->accept(visitor);
+  }
+
+  // Print one line per node, in index order.
+  void dump(std::ostream &ostream) const;
+
+  // Print the tree as Tiger source, as ASTDumper does.
+  void dump_source(std::ostream &ostream, bool verbose) const;
+};
+
+} // namespace flat
+} // namespace ast
+
+#endif // FLAT_AST_HH
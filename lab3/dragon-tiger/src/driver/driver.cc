@@ -1,8 +1,8 @@
 #include <boost/program_options.hpp>
 #include <iostream>
 
-#include "../ast/ast_dumper.hh"
 #include "../ast/binder.hh"
+#include "../ast/flat_ast.hh"
 #include "../ast/type_checker.hh"
 #include "../parser/parser_driver.hh"
 #include "../utils/errors.hh"
@@ -15,6 +15,7 @@ int main(int argc, char **argv) {
   options.add_options()
   ("help,h", "describe arguments")
   ("dump-ast", "dump the parsed AST")
+  ("dump-flat-ast", "dump the flat representation of the AST")
   ("bind,b", "run the binder on the parsed AST")
   ("trace-parser", "enable parser traces")
   ("trace-lexer", "enable lexer traces")
@@ -59,13 +60,15 @@ int main(int argc, char **argv) {
    main->accept(type_checker);
   }
 
-  if (vm.count("dump-ast")) {
-    ast::ASTDumper dumper(&std::cout, vm.count("verbose") > 0);
-    if (main)
-      main->accept(dumper);
-    else
-      parser_driver.result_ast->accept(dumper);
-    dumper.nl();
+  if (vm.count("dump-ast") || vm.count("dump-flat-ast")) {
+    ast::flat::FlatAST flat(main ? static_cast<Node &>(*main)
+                                 : *parser_driver.result_ast);
+    if (vm.count("dump-ast")) {
+      flat.dump_source(std::cout, vm.count("verbose") > 0);
+      std::cout << std::endl;
+    }
+    if (vm.count("dump-flat-ast"))
+      flat.dump(std::cout);
   }
   delete parser_driver.result_ast;
   return 0;
@@ -0,0 +1,292 @@
+#include "constant_folder.hh"
+
+namespace ast {
+namespace constant_folder {
+
+namespace {
+
+// Collect the variables which are assigned somewhere in the program.
+class AssignmentCollector : public ConstASTVisitor {
+public:
+  std::unordered_set<const VarDecl *> assigned;
+
+  virtual void visit(const IntegerLiteral &) {}
+  virtual void visit(const StringLiteral &) {}
+  virtual void visit(const BinaryOperator &op) {
+    op.get_left().accept(*this);
+    op.get_right().accept(*this);
+  }
+  virtual void visit(const Sequence &seq) {
+    for (auto expr : seq.get_exprs())
+      expr->accept(*this);
+  }
+  virtual void visit(const Let &let) {
+    for (auto decl : let.get_decls())
+      decl->accept(*this);
+    let.get_sequence().accept(*this);
+  }
+  virtual void visit(const Identifier &) {}
+  virtual void visit(const IfThenElse &ite) {
+    ite.get_condition().accept(*this);
+    ite.get_then_part().accept(*this);
+    ite.get_else_part().accept(*this);
+  }
+  virtual void visit(const VarDecl &decl) {
+    if (auto expr = decl.get_expr())
+      expr->accept(*this);
+  }
+  virtual void visit(const FunDecl &decl) {
+    if (auto expr = decl.get_expr())
+      expr->accept(*this);
+  }
+  virtual void visit(const FunCall &call) {
+    for (auto arg : call.get_args())
+      arg->accept(*this);
+  }
+  virtual void visit(const WhileLoop &loop) {
+    loop.get_condition().accept(*this);
+    loop.get_body().accept(*this);
+  }
+  virtual void visit(const ForLoop &loop) {
+    loop.get_variable().accept(*this);
+    loop.get_high().accept(*this);
+    loop.get_body().accept(*this);
+  }
+  virtual void visit(const Break &) {}
+  virtual void visit(const Assign &assign) {
+    if (auto decl = assign.get_lhs().get_decl())
+      assigned.insert(&decl.get());
+    assign.get_rhs().accept(*this);
+  }
+};
+
+const IntegerLiteral *as_int(const Expr &expr) {
+  return dynamic_cast<const IntegerLiteral *>(&expr);
+}
+
+const StringLiteral *as_string(const Expr &expr) {
+  return dynamic_cast<const StringLiteral *>(&expr);
+}
+
+int32_t compare(const std::string &a, const std::string &b) {
+  const int result = a.compare(b);
+  return result < 0 ? -1 : result > 0;
+}
+
+} // namespace
+
+void ConstantFolder::fold_program(FunDecl &main) {
+  AssignmentCollector collector;
+  main.accept(collector);
+  assigned = std::move(collector.assigned);
+  main.accept(*this);
+}
+
+// Visit an expression and return the expression replacing it.
+Expr *ConstantFolder::fold(Expr &expr) {
+  result = &expr;
+  expr.accept(*this);
+  return result;
+}
+
+void ConstantFolder::replace_by_int(const Expr &old, int32_t value) {
+  result = new IntegerLiteral(old.loc, value);
+  result->set_type(t_int);
+}
+
+void ConstantFolder::replace_by_string(const Expr &old,
+                                       const std::string &value) {
+  result = new StringLiteral(old.loc, Symbol(value));
+  result->set_type(t_string);
+}
+
+void ConstantFolder::visit(IntegerLiteral &literal) { result = &literal; }
+
+void ConstantFolder::visit(StringLiteral &literal) { result = &literal; }
+
+void ConstantFolder::visit(BinaryOperator &op) {
+  op.set_left(fold(op.get_left()));
+  op.set_right(fold(op.get_right()));
+  result = &op;
+
+  if (as_int(op.get_left()) && as_int(op.get_right())) {
+    const int32_t a = as_int(op.get_left())->value;
+    const int32_t b = as_int(op.get_right())->value;
+    // Arithmetic wraps around, as in the generated code.
+    switch (op.op) {
+    case o_plus:
+      return replace_by_int(op, uint32_t(a) + uint32_t(b));
+    case o_minus:
+      return replace_by_int(op, uint32_t(a) - uint32_t(b));
+    case o_times:
+      return replace_by_int(op, uint32_t(a) * uint32_t(b));
+    case o_divide:
+      if (b == 0 || (a == INT32_MIN && b == -1))
+        return;
+      return replace_by_int(op, a / b);
+    case o_eq:
+      return replace_by_int(op, a == b);
+    case o_neq:
+      return replace_by_int(op, a != b);
+    case o_lt:
+      return replace_by_int(op, a < b);
+    case o_le:
+      return replace_by_int(op, a <= b);
+    case o_gt:
+      return replace_by_int(op, a > b);
+    case o_ge:
+      return replace_by_int(op, a >= b);
+    }
+  }
+
+  if (as_string(op.get_left()) && as_string(op.get_right())) {
+    const int32_t c = compare(as_string(op.get_left())->value.get(),
+                              as_string(op.get_right())->value.get());
+    switch (op.op) {
+    case o_eq:
+      return replace_by_int(op, c == 0);
+    case o_neq:
+      return replace_by_int(op, c != 0);
+    case o_lt:
+      return replace_by_int(op, c < 0);
+    case o_le:
+      return replace_by_int(op, c <= 0);
+    case o_gt:
+      return replace_by_int(op, c > 0);
+    case o_ge:
+      return replace_by_int(op, c >= 0);
+    default:
+      return;
+    }
+  }
+}
+
+void ConstantFolder::visit(Sequence &seq) {
+  for (auto &expr : seq.get_exprs())
+    expr = fold(*expr);
+  result = &seq;
+}
+
+void ConstantFolder::visit(Let &let) {
+  for (auto decl : let.get_decls())
+    decl->accept(*this);
+  let.get_sequence().accept(*this);
+  result = &let;
+}
+
+void ConstantFolder::visit(Identifier &id) {
+  result = &id;
+  auto constant = constants.find(&id.get_decl().get());
+  if (constant == constants.end())
+    return;
+  if (auto literal = as_int(*constant->second))
+    replace_by_int(id, literal->value);
+  else
+    replace_by_string(id, as_string(*constant->second)->value.get());
+}
+
+void ConstantFolder::visit(IfThenElse &ite) {
+  ite.set_condition(fold(ite.get_condition()));
+  ite.set_then_part(fold(ite.get_then_part()));
+  ite.set_else_part(fold(ite.get_else_part()));
+  result = &ite;
+  if (auto condition = as_int(ite.get_condition()))
+    result = condition->value ? &ite.get_then_part() : &ite.get_else_part();
+}
+
+void ConstantFolder::visit(VarDecl &decl) {
+  if (auto expr = decl.get_expr()) {
+    decl.set_expr(fold(expr.get()));
+    // Loop indices are read-only but still change.
+    const Expr &value = decl.get_expr().get();
+    if (!decl.read_only && !assigned.count(&decl) &&
+        (as_int(value) || as_string(value)))
+      constants[&decl] = &value;
+  }
+}
+
+void ConstantFolder::visit(FunDecl &decl) {
+  if (auto expr = decl.get_expr())
+    decl.set_expr(fold(expr.get()));
+}
+
+void ConstantFolder::visit(FunCall &call) {
+  for (auto &arg : call.get_args())
+    arg = fold(*arg);
+  result = &call;
+
+  const FunDecl &decl = call.get_decl().get();
+  if (decl.get_expr())
+    return;
+  for (auto arg : call.get_args())
+    if (!as_int(*arg) && !as_string(*arg))
+      return;
+  fold_primitive(call, decl.get_external_name().get());
+}
+
+// Fold a call to a primitive whose arguments are all literals. Return
+// false if the primitive has side effects or would fail at runtime.
+bool ConstantFolder::fold_primitive(FunCall &call, const std::string &name) {
+  const std::vector<Expr *> &args = call.get_args();
+  auto int_arg = [&](int i) { return as_int(*args[i])->value; };
+  auto string_arg = [&](int i) -> const std::string & {
+    return as_string(*args[i])->value.get();
+  };
+
+  if (name == "__not") {
+    replace_by_int(call, !int_arg(0));
+  } else if (name == "__size") {
+    replace_by_int(call, string_arg(0).size());
+  } else if (name == "__ord") {
+    const std::string &s = string_arg(0);
+    replace_by_int(call, s.empty() ? -1 : (unsigned char)s[0]);
+  } else if (name == "__chr") {
+    const int32_t c = int_arg(0);
+    if (c < 0 || c > 255)
+      return false;
+    replace_by_string(call, c ? std::string(1, char(c)) : "");
+  } else if (name == "__concat") {
+    replace_by_string(call, string_arg(0) + string_arg(1));
+  } else if (name == "__substring") {
+    const std::string &s = string_arg(0);
+    const int32_t first = int_arg(1), length = int_arg(2);
+    if (first < 0 || length < 0 || int64_t(first) + length > int64_t(s.size()))
+      return false;
+    replace_by_string(call, s.substr(first, length));
+  } else if (name == "__strcmp") {
+    replace_by_int(call, compare(string_arg(0), string_arg(1)));
+  } else if (name == "__streq") {
+    replace_by_int(call, string_arg(0) == string_arg(1));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void ConstantFolder::visit(WhileLoop &loop) {
+  loop.set_condition(fold(loop.get_condition()));
+  loop.set_body(fold(loop.get_body()));
+  result = &loop;
+  auto condition = as_int(loop.get_condition());
+  if (condition && condition->value == 0) {
+    result = new Sequence(loop.loc, std::vector<Expr *>());
+    result->set_type(t_void);
+  }
+}
+
+void ConstantFolder::visit(ForLoop &loop) {
+  loop.get_variable().accept(*this);
+  loop.set_high(fold(loop.get_high()));
+  loop.set_body(fold(loop.get_body()));
+  result = &loop;
+}
+
+void ConstantFolder::visit(Break &b) { result = &b; }
+
+void ConstantFolder::visit(Assign &assign) {
+  assign.set_rhs(fold(assign.get_rhs()));
+  result = &assign;
+}
+
+} // namespace constant_folder
+} // namespace ast
@@ -0,0 +1,57 @@
+#ifndef CONSTANT_FOLDER_HH
+#define CONSTANT_FOLDER_HH
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "nodes.hh"
+
+namespace ast {
+namespace constant_folder {
+
+// Rewrite a bound and type-checked program, replacing expressions
+// whose value is known at compile time by literals:
+//   - integer and string comparisons and integer arithmetic on
+//     literals (except divisions by zero, left for the runtime);
+//   - uses of variables initialized with a literal and never assigned;
+//   - calls to side-effect free primitives with literal arguments;
+//   - conditionals whose condition is a literal;
+//   - while loops whose condition is 0, which become empty sequences.
+//
+// Replaced nodes are not freed, as pruned branches may hold
+// declarations that the binder has linked from elsewhere.
+class ConstantFolder : public ASTVisitor {
+  // The expression replacing the node being visited.
+  Expr *result;
+  // Variables which are the target of an assignment.
+  std::unordered_set<const VarDecl *> assigned;
+  // Literal values of constant variables.
+  std::unordered_map<const VarDecl *, const Expr *> constants;
+
+  Expr *fold(Expr &);
+  void replace_by_int(const Expr &, int32_t value);
+  void replace_by_string(const Expr &, const std::string &value);
+  bool fold_primitive(FunCall &, const std::string &name);
+
+public:
+  void fold_program(FunDecl &main);
+  virtual void visit(IntegerLiteral &);
+  virtual void visit(StringLiteral &);
+  virtual void visit(BinaryOperator &);
+  virtual void visit(Sequence &);
+  virtual void visit(Let &);
+  virtual void visit(Identifier &);
+  virtual void visit(IfThenElse &);
+  virtual void visit(VarDecl &);
+  virtual void visit(FunDecl &);
+  virtual void visit(FunCall &);
+  virtual void visit(WhileLoop &);
+  virtual void visit(ForLoop &);
+  virtual void visit(Break &);
+  virtual void visit(Assign &);
+};
+
+} // namespace constant_folder
+} // namespace ast
+
+#endif // CONSTANT_FOLDER_HH
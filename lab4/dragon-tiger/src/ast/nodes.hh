@@ -234,11 +234,19 @@ public:
     delete left;
   }
 
-  // Getters for field `left'
+  // Setter and getters for field `left'
+  void set_left(Expr *_left) {
+    assert(_left);
+    left = _left;
+  }
   Expr &get_left() { return *left; }
   const Expr &get_left() const { return *left; }
 
-  // Getters for field `right'
+  // Setter and getters for field `right'
+  void set_right(Expr *_right) {
+    assert(_right);
+    right = _right;
+  }
   Expr &get_right() { return *right; }
   const Expr &get_right() const { return *right; }
 
@@ -392,15 +400,27 @@ public:
     delete condition;
   }
 
-  // Getters for field `condition'
+  // Setter and getters for field `condition'
+  void set_condition(Expr *_condition) {
+    assert(_condition);
+    condition = _condition;
+  }
   Expr &get_condition() { return *condition; }
   const Expr &get_condition() const { return *condition; }
 
-  // Getters for field `then_part'
+  // Setter and getters for field `then_part'
+  void set_then_part(Expr *_then_part) {
+    assert(_then_part);
+    then_part = _then_part;
+  }
   Expr &get_then_part() { return *then_part; }
   const Expr &get_then_part() const { return *then_part; }
 
-  // Getters for field `else_part'
+  // Setter and getters for field `else_part'
+  void set_else_part(Expr *_else_part) {
+    assert(_else_part);
+    else_part = _else_part;
+  }
   Expr &get_else_part() { return *else_part; }
   const Expr &get_else_part() const { return *else_part; }
 
@@ -435,7 +455,11 @@ public:
   // Destructor
   virtual ~VarDecl() { delete expr; }
 
-  // Getters for field `expr'
+  // Setter and getters for field `expr'
+  void set_expr(Expr *_expr) {
+    assert(expr && _expr);
+    expr = _expr;
+  }
   optional<Expr &> get_expr() {
     if (!expr)
       return boost::none;
@@ -495,7 +519,11 @@ public:
   std::vector<VarDecl *> &get_params() { return params; }
   const std::vector<VarDecl *> &get_params() const { return params; }
 
-  // Getters for field `expr'
+  // Setter and getters for field `expr'
+  void set_expr(Expr *_expr) {
+    assert(expr && _expr);
+    expr = _expr;
+  }
   optional<Expr &> get_expr() {
     if (!expr)
       return boost::none;
@@ -632,11 +660,19 @@ public:
     delete condition;
   }
 
-  // Getters for field `condition'
+  // Setter and getters for field `condition'
+  void set_condition(Expr *_condition) {
+    assert(_condition);
+    condition = _condition;
+  }
   Expr &get_condition() { return *condition; }
   const Expr &get_condition() const { return *condition; }
 
-  // Getters for field `body'
+  // Setter and getters for field `body'
+  void set_body(Expr *_body) {
+    assert(_body);
+    body = _body;
+  }
   Expr &get_body() { return *body; }
   const Expr &get_body() const { return *body; }
 
@@ -674,11 +710,19 @@ public:
   VarDecl &get_variable() { return *variable; }
   const VarDecl &get_variable() const { return *variable; }
 
-  // Getters for field `high'
+  // Setter and getters for field `high'
+  void set_high(Expr *_high) {
+    assert(_high);
+    high = _high;
+  }
   Expr &get_high() { return *high; }
   const Expr &get_high() const { return *high; }
 
-  // Getters for field `body'
+  // Setter and getters for field `body'
+  void set_body(Expr *_body) {
+    assert(_body);
+    body = _body;
+  }
   Expr &get_body() { return *body; }
   const Expr &get_body() const { return *body; }
 
@@ -750,7 +794,11 @@ public:
   Identifier &get_lhs() { return *lhs; }
   const Identifier &get_lhs() const { return *lhs; }
 
-  // Getters for field `rhs'
+  // Setter and getters for field `rhs'
+  void set_rhs(Expr *_rhs) {
+    assert(_rhs);
+    rhs = _rhs;
+  }
   Expr &get_rhs() { return *rhs; }
   const Expr &get_rhs() const { return *rhs; }
 
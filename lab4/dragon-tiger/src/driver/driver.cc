@@ -3,6 +3,7 @@
 
 #include "../ast/ast_dumper.hh"
 #include "../ast/binder.hh"
+#include "../ast/constant_folder.hh"
 #include "../ast/escaper.hh"
 #include "../ast/type_checker.hh"
 #include "../parser/parser_driver.hh"
@@ -11,6 +12,8 @@
 
 int main(int argc, char **argv) {
   std::string output_file;
+  std::string bitcode_file;
+  unsigned jobs;
   std::vector<std::string> input_files;
   namespace po = boost::program_options;
   po::options_description options("Options");
@@ -18,9 +21,13 @@ int main(int argc, char **argv) {
   ("help,h", "describe arguments")
   ("dump-ast", "dump the parsed AST")
   ("dump-ir", "dump the generated IR")
+  ("emit-bc", po::value(&bitcode_file), "write the generated IR as bitcode")
   ("bind,b", "run the binder on the parsed AST")
   ("type,t", "run the type checker on the parsed AST")
+  ("fold,f", "fold constant expressions (implies --type)")
   ("irgen,i", "run the LLVM IR code generator")
+  ("jobs,j", po::value(&jobs)->default_value(1),
+   "number of threads used to generate the IR")
   ("trace-parser", "enable parser traces")
   ("trace-lexer", "enable lexer traces")
   ("verbose,v", "be verbose")
@@ -52,25 +59,37 @@ int main(int argc, char **argv) {
     utils::error("parser failed");
   }
 
+  const bool irgen = vm.count("irgen") || vm.count("emit-bc");
+  const bool fold = vm.count("fold") > 0;
+
   FunDecl *main = nullptr;
-  if (vm.count("bind") || vm.count("type") || vm.count("irgen")) {
+  if (vm.count("bind") || vm.count("type") || fold || irgen) {
     ast::binder::Binder binder;
     main = binder.analyze_program(*parser_driver.result_ast);
     ast::escaper::Escaper escaper;
     main->accept(escaper);
   }
 
-  if (vm.count("type") || vm.count("irgen")) {
+  if (vm.count("type") || fold || irgen) {
     ast::type_checker::TypeChecker type_checker;
     main->accept(type_checker);
   }
 
-  if (vm.count("irgen")) {
+  if (fold) {
+    ast::constant_folder::ConstantFolder folder;
+    folder.fold_program(*main);
+  }
+
+  if (irgen) {
     irgen::IRGenerator ir_generator;
-    ir_generator.generate_program(main);
+    ir_generator.generate_program(main, jobs);
 
     if (vm.count("dump-ir")) {
-      ir_generator.print_ir(&std::cout);
+      ir_generator.print_ir("-");
+    }
+
+    if (vm.count("emit-bc")) {
+      ir_generator.write_bitcode(bitcode_file);
     }
   }
 
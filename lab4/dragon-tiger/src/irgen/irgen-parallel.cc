@@ -0,0 +1,154 @@
+#include <thread>
+
+#include "irgen.hh"
+#include "../utils/errors.hh"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#if LLVM_VERSION_MAJOR >= 4
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#else
+#include "llvm/Bitcode/ReaderWriter.h"
+#endif
+
+using utils::error;
+
+namespace irgen {
+
+namespace {
+
+// Collect every function declaration with a body, in the order in
+// which they appear in the program.
+class FunctionCollector : public ConstASTVisitor {
+public:
+  std::vector<const FunDecl *> functions;
+
+  virtual void visit(const IntegerLiteral &) {}
+  virtual void visit(const StringLiteral &) {}
+  virtual void visit(const BinaryOperator &op) {
+    op.get_left().accept(*this);
+    op.get_right().accept(*this);
+  }
+  virtual void visit(const Sequence &seq) {
+    for (auto expr : seq.get_exprs())
+      expr->accept(*this);
+  }
+  virtual void visit(const Let &let) {
+    for (auto decl : let.get_decls())
+      decl->accept(*this);
+    let.get_sequence().accept(*this);
+  }
+  virtual void visit(const Identifier &) {}
+  virtual void visit(const IfThenElse &ite) {
+    ite.get_condition().accept(*this);
+    ite.get_then_part().accept(*this);
+    ite.get_else_part().accept(*this);
+  }
+  virtual void visit(const VarDecl &decl) {
+    if (decl.get_expr())
+      decl.get_expr()->accept(*this);
+  }
+  virtual void visit(const FunDecl &decl) {
+    if (!decl.get_expr())
+      return;
+    functions.push_back(&decl);
+    decl.get_expr()->accept(*this);
+  }
+  virtual void visit(const FunCall &call) {
+    for (auto arg : call.get_args())
+      arg->accept(*this);
+  }
+  virtual void visit(const WhileLoop &loop) {
+    loop.get_condition().accept(*this);
+    loop.get_body().accept(*this);
+  }
+  virtual void visit(const ForLoop &loop) {
+    loop.get_variable().accept(*this);
+    loop.get_high().accept(*this);
+    loop.get_body().accept(*this);
+  }
+  virtual void visit(const Break &) {}
+  virtual void visit(const Assign &assign) {
+    assign.get_rhs().accept(*this);
+  }
+};
+
+} // namespace
+
+std::string
+IRGenerator::generate_shard(const std::vector<const FunDecl *> &functions,
+                            const std::vector<const FunDecl *> &shard) {
+  for (auto decl : functions)
+    declare_function(*decl, llvm::Function::ExternalLinkage);
+
+  for (auto decl : shard) {
+    generate_function(*decl);
+    // Inner functions are already assigned to a shard.
+    pending_func_bodies.clear();
+  }
+
+  std::string bitcode;
+  llvm::raw_string_ostream OS(bitcode);
+  llvm::WriteBitcodeToFile(Mod.get(), OS);
+  OS.flush();
+  return bitcode;
+}
+
+void IRGenerator::generate_program_parallel(FunDecl *main, unsigned jobs) {
+  FunctionCollector collector;
+  main->accept(collector);
+  const std::vector<const FunDecl *> &functions = collector.functions;
+
+  // Deal the functions round-robin, since nested functions are
+  // listed right after their parent and tend to be of similar size.
+  if (jobs > functions.size())
+    jobs = functions.size();
+  std::vector<std::vector<const FunDecl *>> shards(jobs);
+  for (size_t i = 0; i < functions.size(); i++)
+    shards[i % jobs].push_back(functions[i]);
+
+  // An LLVM context cannot be shared between threads, so every
+  // shard gets its own generator.
+  std::vector<std::string> bitcodes(jobs);
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < jobs; i++)
+    workers.emplace_back([&functions, &shards, &bitcodes, i]() {
+      IRGenerator generator;
+      bitcodes[i] = generator.generate_shard(functions, shards[i]);
+    });
+  for (auto &worker : workers)
+    worker.join();
+
+  for (unsigned i = 0; i < jobs; i++) {
+    // The reader reports errors with llvm::Error since LLVM 4.
+#if LLVM_VERSION_MAJOR >= 4
+    llvm::Expected<std::unique_ptr<llvm::Module>> shard =
+        llvm::parseBitcodeFile(
+            llvm::MemoryBufferRef(bitcodes[i], "shard"), Context);
+    if (!shard)
+      error("cannot load generated code: " +
+            llvm::toString(shard.takeError()));
+#else
+    llvm::ErrorOr<std::unique_ptr<llvm::Module>> shard =
+        llvm::parseBitcodeFile(
+            llvm::MemoryBufferRef(bitcodes[i], "shard"), Context);
+    if (!shard)
+      error("cannot load generated code: " + shard.getError().message());
+#endif
+    if (llvm::Linker::linkModules(*Mod, std::move(*shard)))
+      error("cannot link generated code");
+    bitcodes[i].clear();
+  }
+
+  // Inner functions can be made local again now that every
+  // reference to them has been resolved.
+  for (auto decl : functions)
+    if (!decl->is_external)
+      Mod->getFunction(decl->get_external_name().get())
+          ->setLinkage(llvm::Function::InternalLinkage);
+}
+
+} // namespace irgen
@@ -0,0 +1,123 @@
+#include "irgen.hh"
+
+namespace irgen {
+
+llvm::Function *IRGenerator::callee_of(const FunDecl &decl) {
+  // Look up the name in the global module table.
+  llvm::Function *callee = Mod->getFunction(decl.get_external_name().get());
+
+  if (!callee) {
+    // This should only happen for primitives whose Decl is out of the AST
+    // and has not yet been handled
+    assert(!decl.get_expr());
+    decl.accept(*this);
+    callee = Mod->getFunction(decl.get_external_name().get());
+  }
+  return callee;
+}
+
+// A string header is { i32 kind, i32 length }, right before the
+// characters the string points to.
+
+llvm::Value *IRGenerator::string_kind(llvm::Value *s) {
+  llvm::Value *const address = Builder.CreateBitCast(
+      Builder.CreateInBoundsGEP(s, Builder.getInt32(-8)),
+      Builder.getInt32Ty()->getPointerTo());
+  return Builder.CreateLoad(address, "kind");
+}
+
+llvm::Value *IRGenerator::string_length(llvm::Value *s) {
+  llvm::Value *const address = Builder.CreateBitCast(
+      Builder.CreateInBoundsGEP(s, Builder.getInt32(-4)),
+      Builder.getInt32Ty()->getPointerTo());
+  return Builder.CreateLoad(address, "length");
+}
+
+llvm::Value *IRGenerator::string_equal(llvm::Value *l, llvm::Value *r) {
+  llvm::BasicBlock *const entry_block = Builder.GetInsertBlock();
+  llvm::BasicBlock *const length_block =
+      llvm::BasicBlock::Create(Context, "streq_length", current_function);
+  llvm::BasicBlock *const call_block =
+      llvm::BasicBlock::Create(Context, "streq_call", current_function);
+  llvm::BasicBlock *const end_block =
+      llvm::BasicBlock::Create(Context, "streq_end", current_function);
+
+  Builder.CreateCondBr(Builder.CreateICmpEQ(l, r), end_block, length_block);
+
+  Builder.SetInsertPoint(length_block);
+  Builder.CreateCondBr(
+      Builder.CreateICmpEQ(string_length(l), string_length(r)), call_block,
+      end_block);
+
+  Builder.SetInsertPoint(call_block);
+  auto const streq = Mod->getOrInsertFunction(
+      "__streq", Builder.getInt32Ty(), Builder.getInt8PtrTy(),
+      Builder.getInt8PtrTy(), nullptr);
+  llvm::Value *const result = Builder.CreateCall(streq, {l, r}, "streq");
+  Builder.CreateBr(end_block);
+
+  Builder.SetInsertPoint(end_block);
+  llvm::PHINode *const phi = Builder.CreatePHI(Builder.getInt32Ty(), 3);
+  phi->addIncoming(Builder.getInt32(1), entry_block);
+  phi->addIncoming(Builder.getInt32(0), length_block);
+  phi->addIncoming(result, call_block);
+  return phi;
+}
+
+llvm::Value *IRGenerator::inline_primitive(
+    const FunDecl &decl, const std::vector<llvm::Value *> &args) {
+  const std::string &name = decl.get_external_name().get();
+
+  if (name == "__not")
+    return Builder.CreateZExt(
+        Builder.CreateICmpEQ(args[0], Builder.getInt32(0)),
+        Builder.getInt32Ty(), "not");
+
+  // The length is in the header of every kind of string.
+  if (name == "__size")
+    return string_length(args[0]);
+
+  if (name == "__streq")
+    return string_equal(args[0], args[1]);
+
+  // The first character of a flat string can be read directly, the
+  // runtime is only called for other kinds of strings.
+  if (name == "__ord") {
+    llvm::Value *const s = args[0];
+    llvm::BasicBlock *const flat_block =
+        llvm::BasicBlock::Create(Context, "ord_flat", current_function);
+    llvm::BasicBlock *const call_block =
+        llvm::BasicBlock::Create(Context, "ord_call", current_function);
+    llvm::BasicBlock *const end_block =
+        llvm::BasicBlock::Create(Context, "ord_end", current_function);
+
+    Builder.CreateCondBr(
+        Builder.CreateICmpEQ(string_kind(s), Builder.getInt32(0)), flat_block,
+        call_block);
+
+    // Empty strings are null-terminated too, so reading their first
+    // character is safe.
+    Builder.SetInsertPoint(flat_block);
+    llvm::Value *const first = Builder.CreateZExt(
+        Builder.CreateLoad(s), Builder.getInt32Ty());
+    llvm::Value *const flat_result = Builder.CreateSelect(
+        Builder.CreateICmpEQ(string_length(s), Builder.getInt32(0)),
+        Builder.getInt32(-1), first);
+    Builder.CreateBr(end_block);
+
+    Builder.SetInsertPoint(call_block);
+    llvm::Value *const call_result = Builder.CreateCall(callee_of(decl), {s});
+    Builder.CreateBr(end_block);
+
+    Builder.SetInsertPoint(end_block);
+    llvm::PHINode *const phi =
+        Builder.CreatePHI(Builder.getInt32Ty(), 2, "ord");
+    phi->addIncoming(flat_result, flat_block);
+    phi->addIncoming(call_result, call_block);
+    return phi;
+  }
+
+  return nullptr;
+}
+
+} // namespace irgen
@@ -2,6 +2,7 @@
 #include <iostream> // For std::cerr
 #include "irgen.hh"
 
+#include "llvm/Config/llvm-config.h"
 #include "llvm/Support/raw_ostream.h"
 
 namespace {
@@ -21,7 +22,32 @@ llvm::Value *IRGenerator::visit(const IntegerLiteral &literal) {
 }
 
 llvm::Value *IRGenerator::visit(const StringLiteral &literal) {
-  return Builder.CreateGlobalStringPtr(literal.value.get());
+  llvm::Constant *&chars = string_literals[literal.value];
+  if (chars)
+    return chars;
+
+  // A string is a pointer to its null-terminated characters, preceded
+  // by a header holding its kind (0 for a flat string) and its length,
+  // as expected by the runtime.
+  const std::string &value = literal.value.get();
+  llvm::Constant *const fields[] = {
+      Builder.getInt32(0), Builder.getInt32(value.size()),
+      llvm::ConstantDataArray::getString(Context, value)};
+  llvm::Constant *const init = llvm::ConstantStruct::getAnon(Context, fields);
+  llvm::GlobalVariable *const global = new llvm::GlobalVariable(
+      *Mod, init->getType(), true, llvm::GlobalValue::PrivateLinkage, init,
+      "str");
+#if LLVM_VERSION_MAJOR > 3 || LLVM_VERSION_MINOR >= 9
+  global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+#else
+  global->setUnnamedAddr(true);
+#endif
+  global->setAlignment(4);
+  llvm::Constant *const indices[] = {Builder.getInt32(0), Builder.getInt32(2),
+                                     Builder.getInt32(0)};
+  chars = llvm::ConstantExpr::getInBoundsGetElementPtr(init->getType(), global,
+                                                       indices);
+  return chars;
 }
 
 llvm::Value *IRGenerator::visit(const Break &b) {
@@ -34,6 +60,11 @@ llvm::Value *IRGenerator::visit(const BinaryOperator &op) {
   llvm::Value *r = op.get_right().accept(*this);
 
   if (op.get_left().get_type() == t_string) {
+    if (op.op == o_eq)
+      return string_equal(l, r);
+    if (op.op == o_neq)
+      return Builder.CreateXor(string_equal(l, r), Builder.getInt32(1));
+
     auto const strcmp = Mod->getOrInsertFunction(
         "__strcmp", Builder.getInt32Ty(), Builder.getInt8PtrTy(),
         Builder.getInt8PtrTy(), nullptr);
@@ -63,7 +94,7 @@ llvm::Value *IRGenerator::visit(const BinaryOperator &op) {
     default: assert(false); __builtin_unreachable();
   }
 
-  return Builder.CreateIntCast(cmp, Builder.getInt32Ty(), true);
+  return Builder.CreateIntCast(cmp, Builder.getInt32Ty(), false);
 }
 
 llvm::Value *IRGenerator::visit(const Sequence &seq) {
@@ -139,21 +170,8 @@ llvm::Value *IRGenerator::visit(const VarDecl &decl) {
 }
 
 llvm::Value *IRGenerator::visit(const FunDecl &decl) {
-  std::vector<llvm::Type *> param_types;
-
-  for (auto param_decl : decl.get_params()) {
-    param_types.push_back(llvm_type(param_decl->get_type()));
-  }
-
-  llvm::Type *return_type = llvm_type(decl.get_type());
-
-  llvm::FunctionType *ft =
-      llvm::FunctionType::get(return_type, param_types, false);
-
-  llvm::Function::Create(ft,
-                         decl.is_external ? llvm::Function::ExternalLinkage
-                                          : llvm::Function::InternalLinkage,
-                         decl.get_external_name().get(), Mod.get());
+  declare_function(decl, decl.is_external ? llvm::Function::ExternalLinkage
+                                          : llvm::Function::InternalLinkage);
 
   if (decl.get_expr())
     pending_func_bodies.push_front(&decl);
@@ -162,24 +180,19 @@ llvm::Value *IRGenerator::visit(const FunDecl &decl) {
 }
 
 llvm::Value *IRGenerator::visit(const FunCall &call) {
-  // Look up the name in the global module table.
   const FunDecl &decl = call.get_decl().get();
-  llvm::Function *callee =
-      Mod->getFunction(decl.get_external_name().get());
-
-  if (!callee) {
-    // This should only happen for primitives whose Decl is out of the AST
-    // and has not yet been handled
-    assert(!decl.get_expr());
-    decl.accept(*this);
-    callee = Mod->getFunction(decl.get_external_name().get());
-  }
 
   std::vector<llvm::Value *> args_values;
   for (auto expr : call.get_args()) {
     args_values.push_back(expr->accept(*this));
   }
 
+  if (!decl.get_expr()) {
+    if (llvm::Value *const value = inline_primitive(decl, args_values))
+      return value;
+  }
+
+  llvm::Function *const callee = callee_of(decl);
   if (decl.get_type() == t_void) {
     Builder.CreateCall(callee, args_values);
     return nullptr;
@@ -1,8 +1,15 @@
 #include "irgen.hh"
 #include "../utils/errors.hh"
 
+#include "llvm/Config/llvm-config.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/raw_ostream.h"
+#if LLVM_VERSION_MAJOR >= 4
+#include "llvm/Bitcode/BitcodeWriter.h"
+#else
+#include "llvm/Bitcode/ReaderWriter.h"
+#endif
 
 using utils::error;
 
@@ -34,14 +41,22 @@ llvm::Value *IRGenerator::alloca_in_entry(llvm::Type *Ty,
   return value;
 }
 
-void IRGenerator::print_ir(std::ostream *ostream) {
-  // FIXME: This is inefficient. Should probably take a filename
-  // and use directly LLVM raw stream interface
-  std::string buffer;
-  llvm::raw_string_ostream OS(buffer);
+void IRGenerator::print_ir(const std::string &filename) {
+  // The module is streamed as it is printed, so that we never
+  // hold its whole textual representation in memory.
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(filename, EC, llvm::sys::fs::F_Text);
+  if (EC)
+    error("cannot open " + filename + ": " + EC.message());
   OS << *Mod;
-  OS.flush();
-  *ostream << buffer;
+}
+
+void IRGenerator::write_bitcode(const std::string &filename) {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(filename, EC, llvm::sys::fs::F_None);
+  if (EC)
+    error("cannot open " + filename + ": " + EC.message());
+  llvm::WriteBitcodeToFile(Mod.get(), OS);
 }
 
 llvm::Value *IRGenerator::address_of(const Identifier &id) {
@@ -50,7 +65,12 @@ llvm::Value *IRGenerator::address_of(const Identifier &id) {
   return allocations[&decl];
 }
 
-void IRGenerator::generate_program(FunDecl *main) {
+void IRGenerator::generate_program(FunDecl *main, unsigned jobs) {
+  if (jobs > 1) {
+    generate_program_parallel(main, jobs);
+    return;
+  }
+
   main->accept(*this);
 
   while (!pending_func_bodies.empty()) {
@@ -59,6 +79,27 @@ void IRGenerator::generate_program(FunDecl *main) {
   }
 }
 
+llvm::Function *
+IRGenerator::declare_function(const FunDecl &decl,
+                              llvm::GlobalValue::LinkageTypes linkage) {
+  const std::string &name = decl.get_external_name().get();
+  if (llvm::Function *existing = Mod->getFunction(name))
+    return existing;
+
+  std::vector<llvm::Type *> param_types;
+
+  for (auto param_decl : decl.get_params()) {
+    param_types.push_back(llvm_type(param_decl->get_type()));
+  }
+
+  llvm::Type *return_type = llvm_type(decl.get_type());
+
+  llvm::FunctionType *ft =
+      llvm::FunctionType::get(return_type, param_types, false);
+
+  return llvm::Function::Create(ft, linkage, name, Mod.get());
+}
+
 void IRGenerator::generate_function(const FunDecl &decl) {
   // Reinitialize common structures.
   allocations.clear();
@@ -2,7 +2,9 @@
 #define IRGEN_HH
 
 #include <deque>
-#include <ostream>
+#include <map>
+#include <string>
+#include <unordered_map>
 
 #include "../ast/nodes.hh"
 
@@ -56,12 +58,34 @@ class IRGenerator : public ConstASTValueVisitor {
   // Frame of the current function.
   llvm::Value *frame;
 
+  // Map string literal values to their global constant, so that
+  // identical literals share the same address, which lets string
+  // equality succeed on the pointer comparison.
+  std::unordered_map<Symbol, llvm::Constant *> string_literals;
+
   // Generate the LLVM IR code corresponding to a function
   // declaration. If inner function declarations are encountered,
   // they will be stored into pending_func_bodies for later
   // processing.
   void generate_function(const FunDecl &);
 
+  // Return the LLVM function corresponding to a function declaration,
+  // creating it with the given linkage if it does not exist yet.
+  llvm::Function *declare_function(const FunDecl &,
+                                   llvm::GlobalValue::LinkageTypes);
+
+  // Generate, into this generator's module, the bodies of the
+  // functions in shard. Every function of the program is declared
+  // with external linkage so that the modules of all the shards can
+  // be linked together. Return the module as bitcode.
+  std::string generate_shard(const std::vector<const FunDecl *> &functions,
+                             const std::vector<const FunDecl *> &shard);
+
+  // Generate the whole program with the given number of threads, each
+  // one using its own context, and link the result into this
+  // generator's module.
+  void generate_program_parallel(FunDecl *, unsigned jobs);
+
   // Return the LLVM type corresponding to a Tiger type.
   llvm::Type *llvm_type(const ast::Type);
 
@@ -73,16 +97,42 @@ class IRGenerator : public ConstASTValueVisitor {
   // Return the address of a given identifier.
   llvm::Value *address_of(const Identifier &id);
 
+  // Return the LLVM function called for a function declaration,
+  // declaring primitives on first use.
+  llvm::Function *callee_of(const FunDecl &);
+
+  // Load the kind or the length of a string from the header which
+  // precedes its characters (see the runtime).
+  llvm::Value *string_kind(llvm::Value *s);
+  llvm::Value *string_length(llvm::Value *s);
+
+  // Generate the IR of a call to a primitive whose semantics are
+  // simple enough to be expanded inline, or return nullptr to let
+  // the caller emit a regular call.
+  llvm::Value *inline_primitive(const FunDecl &,
+                                const std::vector<llvm::Value *> &args);
+
+  // Generate the IR comparing two strings for equality (0 or 1). Only
+  // strings of the same length which are not the same object are
+  // compared by the runtime.
+  llvm::Value *string_equal(llvm::Value *l, llvm::Value *r);
+
 public:
   // Constructor
   IRGenerator();
 
   // Given the main function declaration, generate the LLVM IR
-  // corresponding to the whole program.
-  void generate_program(FunDecl *);
+  // corresponding to the whole program. Function bodies are
+  // generated concurrently when more than one job is requested.
+  void generate_program(FunDecl *, unsigned jobs = 1);
+
+  // Print the generated IR into a file ("-" is the standard output).
+  void print_ir(const std::string &filename);
 
-  // Print the generated IR.
-  void print_ir(std::ostream *);
+  // Write the generated IR as LLVM bitcode into a file ("-" is the
+  // standard output). Bitcode is much faster to write and to load
+  // back than the textual form.
+  void write_bitcode(const std::string &filename);
 
   // Generate the IR corresponding to those AST nodes.
   // Those methods will return either nullptr when no
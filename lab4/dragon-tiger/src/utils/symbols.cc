@@ -1,35 +1,100 @@
-#include <unordered_set>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <vector>
 
 #include "symbols.hh"
 
 namespace {
 
-struct Hash {
-  size_t operator()(std::string const *s) const noexcept {
-    return std::hash<std::string>()(*s);
-  }
+using utils::Symbol;
+
+// Number of independent parts of the symbol table. The shard of a
+// string is chosen from its hash.
+const size_t shard_count = 64;
+
+// A shard is an open-addressing hash table of interned strings, whose
+// size is always a power of two.
+struct Shard {
+  std::mutex lock;
+  std::vector<const Symbol::Entry *> slots;
+  size_t used = 0;
 };
 
-struct Cmp {
-  bool operator()(std::string const *a, std::string const *b) const noexcept {
-    return *a == *b;
+Shard *shards() {
+  static Shard table[shard_count];
+  return table;
+}
+
+// FNV-1a, which lets us hash the bytes without building a std::string.
+// Only new strings get a std::string and its std::hash.
+size_t hash_bytes(const char *s, size_t length) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; i++) {
+    h ^= static_cast<unsigned char>(s[i]);
+    h *= 1099511628211ULL;
   }
-};
+  return static_cast<size_t>(h);
+}
+
+// Position of the first slot to probe for a given hash. The low bits
+// have already been used to select the shard.
+size_t first_slot(size_t hash, size_t slot_count) {
+  return (hash / shard_count) & (slot_count - 1);
+}
 
-std::unordered_set<const std::string *, Hash, Cmp> *symbols;
+void grow(Shard &shard) {
+  std::vector<const Symbol::Entry *> slots(shard.slots.size() * 2);
+  for (auto entry : shard.slots) {
+    if (!entry)
+      continue;
+    size_t i = first_slot(entry->key, slots.size());
+    while (slots[i])
+      i = (i + 1) & (slots.size() - 1);
+    slots[i] = entry;
+  }
+  shard.slots.swap(slots);
+}
 
 } // namespace
 
 namespace utils {
 
-Symbol::Symbol(std::string const &s) {
-  if (symbols == nullptr)
-    symbols = new std::unordered_set<const std::string *, Hash, Cmp>();
-  auto f = symbols->find(&s);
-  if (f == symbols->end())
-    str = *symbols->insert(new std::string(s)).first;
-  else
-    str = *f;
+const Symbol::Entry *Symbol::intern(const char *s, size_t length) {
+  const size_t key = hash_bytes(s, length);
+  Shard &shard = shards()[key % shard_count];
+  std::lock_guard<std::mutex> guard(shard.lock);
+
+  if (shard.slots.empty())
+    shard.slots.resize(64);
+  size_t i = first_slot(key, shard.slots.size());
+  while (const Entry *entry = shard.slots[i]) {
+    if (entry->key == key && entry->str.size() == length &&
+        std::memcmp(entry->str.data(), s, length) == 0)
+      return entry;
+    i = (i + 1) & (shard.slots.size() - 1);
+  }
+
+  std::string str(s, length);
+  const size_t hash = std::hash<std::string>()(str);
+  const Entry *entry = new Entry{std::move(str), hash, key};
+  shard.slots[i] = entry;
+  // Keep the load factor under 3/4.
+  if (++shard.used * 4 > shard.slots.size() * 3)
+    grow(shard);
+  return entry;
+}
+
+Symbol::Symbol(std::string const &s) : entry(intern(s.data(), s.size())) {}
+
+size_t Symbol::table_size() {
+  size_t size = 0;
+  for (size_t i = 0; i < shard_count; i++) {
+    std::lock_guard<std::mutex> guard(shards()[i].lock);
+    size += shards()[i].used;
+  }
+  return size;
 }
 
 } // namespace utils
@@ -0,0 +1,134 @@
+#! /usr/bin/env python3
+#
+# Compile and run the Tiger benchmark corpus, and write the results as
+# JSON.
+#
+# For every program, the harness records the phase report of dtiger
+# (--stats-json), the wall time and peak memory of the compilation, of
+# the generated executable, and of a run in the bytecode VM (--vm). Two
+# synthetic programs, a deeply nested one and one with many functions,
+# are generated to stress the front-end.
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def deep_nesting(depth):
+    """A program nesting lets and arithmetic expressions depth times."""
+    lines = []
+    for i in range(depth):
+        lines.append("let var x%d := %d in" % (i, i))
+    expr = "x%d" % (depth - 1)
+    for i in range(depth):
+        expr = "(%d + %s)" % (i % 7, expr)
+    lines.append("print_int(%s);" % expr)
+    lines.append('print("\\n")')
+    lines.extend(["end"] * depth)
+    return "\n".join(lines) + "\n"
+
+
+def many_functions(count):
+    """A program declaring count functions, each calling the previous one."""
+    lines = ["let", "  function f0(x: int): int = x"]
+    for i in range(1, count):
+        lines.append("  function f%d(x: int): int = f%d(x + %d)"
+                     % (i, i - 1, i % 3))
+    lines.append("in")
+    lines.append("  print_int(f%d(0));" % (count - 1))
+    lines.append('  print("\\n")')
+    lines.append("end")
+    return "\n".join(lines) + "\n"
+
+
+def measure(command, stdout=subprocess.DEVNULL):
+    """Run command and return its exit status, wall time in seconds and
+    peak resident set size in KiB."""
+    start = time.monotonic()
+    process = subprocess.Popen(command, stdout=stdout)
+    _, status, usage = os.wait4(process.pid, 0)
+    elapsed = time.monotonic() - start
+    return os.waitstatus_to_exitcode(status), elapsed, usage.ru_maxrss
+
+
+def fastest(runs):
+    return {"status": runs[0][0],
+            "seconds": min(run[1] for run in runs),
+            "peak_rss_kb": max(run[2] for run in runs)}
+
+
+def bench(dtiger, source, workdir, options, repeat):
+    name = os.path.splitext(os.path.basename(source))[0]
+    executable = os.path.join(workdir, name)
+    stats_file = os.path.join(workdir, name + ".json")
+    result = {"name": name}
+
+    status, seconds, rss = measure([dtiger] + options +
+                                   ["--stats-json", stats_file,
+                                    "-o", executable, source])
+    result["compile"] = {"status": status, "seconds": seconds,
+                         "peak_rss_kb": rss}
+    if status != 0:
+        return result
+    with open(stats_file) as f:
+        result["compile"]["phases"] = json.load(f)["phases"]
+
+    result["run"] = fastest([measure([executable]) for _ in range(repeat)])
+    # Running in the bytecode VM includes the compilation to bytecode.
+    result["vm"] = fastest([measure([dtiger, "--vm", source])
+                            for _ in range(repeat)])
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compile and run the Tiger benchmark corpus.")
+    parser.add_argument("--dtiger", required=True, help="path to dtiger")
+    parser.add_argument("--output", default="-",
+                        help="JSON result file (default: stdout)")
+    parser.add_argument("--repeat", type=int, default=3,
+                        help="runs of each executable, the fastest is kept")
+    parser.add_argument("--depth", type=int, default=1000,
+                        help="nesting depth of the synthetic program")
+    parser.add_argument("--functions", type=int, default=5000,
+                        help="function count of the synthetic program")
+    parser.add_argument("-O", dest="opt_level", default="2",
+                        help="optimization level passed to dtiger")
+    parser.add_argument("sources", nargs="*", help="Tiger programs")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory(prefix="dtiger-bench-") as workdir:
+        sources = list(args.sources)
+        for name, text in (("deep_nesting", deep_nesting(args.depth)),
+                           ("many_functions",
+                            many_functions(args.functions))):
+            path = os.path.join(workdir, name + ".tig")
+            with open(path, "w") as f:
+                f.write(text)
+            sources.append(path)
+
+        results = []
+        for source in sources:
+            print("bench: %s" % os.path.basename(source), file=sys.stderr)
+            results.append(bench(args.dtiger, source, workdir,
+                                 ["-O" + args.opt_level], args.repeat))
+
+    report = {"opt_level": int(args.opt_level), "benchmarks": results}
+    if args.output == "-":
+        json.dump(report, sys.stdout, indent=2)
+        print()
+    else:
+        with open(args.output, "w") as f:
+            json.dump(report, f, indent=2)
+            f.write("\n")
+    return 1 if any(r["compile"]["status"] or r.get("run", {}).get("status")
+                    or r.get("vm", {}).get("status")
+                    for r in results) else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
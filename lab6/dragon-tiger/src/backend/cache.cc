@@ -0,0 +1,98 @@
+#include <sys/stat.h>
+
+#include "cache.hh"
+
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace backend {
+
+namespace {
+
+// Identify the dtiger build: its version, the LLVM it uses and the
+// size and modification time of its executable.
+std::string build_id() {
+  static int anchor;
+  std::string id = TIGER_VERSION " " LLVM_VERSION_STRING;
+  const std::string executable =
+      llvm::sys::fs::getMainExecutable("dtiger", &anchor);
+  struct stat st;
+  if (!executable.empty() && stat(executable.c_str(), &st) == 0)
+    id += " " + std::to_string(st.st_size) + " " +
+          std::to_string(st.st_mtime);
+  return id;
+}
+
+} // namespace
+
+Cache::Cache(const std::string &directory) : directory(directory) {
+  llvm::sys::fs::create_directories(directory);
+}
+
+std::string Cache::key(const std::string &input_file,
+                       const std::vector<std::string> &linked_files,
+                       const std::string &options) const {
+  // Each string or file is preceded by its size, so that their
+  // concatenation is unambiguous.
+  llvm::MD5 hash;
+  auto update = [&hash](llvm::StringRef data) {
+    hash.update(std::to_string(data.size()) + ":");
+    hash.update(data);
+  };
+  update(build_id());
+  update(options);
+  std::vector<std::string> files{input_file};
+  files.insert(files.end(), linked_files.begin(), linked_files.end());
+  for (auto &file : files) {
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> contents =
+        llvm::MemoryBuffer::getFile(file);
+    if (!contents)
+      return "";
+    update((*contents)->getBuffer());
+  }
+  llvm::MD5::MD5Result result;
+  hash.final(result);
+  llvm::SmallString<32> key;
+  llvm::MD5::stringifyResult(result, key);
+  return key.str().str();
+}
+
+std::unique_ptr<llvm::Module> Cache::load(const std::string &key,
+                                          llvm::LLVMContext &context) const {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+      llvm::MemoryBuffer::getFile(directory + "/" + key + ".bc");
+  if (!buffer)
+    return nullptr;
+  llvm::ErrorOr<std::unique_ptr<llvm::Module>> module =
+      llvm::parseBitcodeFile((*buffer)->getMemBufferRef(), context);
+  // A corrupted entry is overwritten by the next store.
+  if (!module)
+    return nullptr;
+  return std::move(*module);
+}
+
+void Cache::store(const std::string &key, const llvm::Module &module) const {
+  int fd;
+  llvm::SmallString<128> temporary;
+  if (llvm::sys::fs::createUniqueFile(directory + "/" + key + "-%%%%%%.tmp",
+                                      fd, temporary))
+    return;
+  {
+    llvm::raw_fd_ostream out(fd, true);
+    llvm::WriteBitcodeToFile(&module, out);
+    out.close();
+    if (out.has_error()) {
+      out.clear_error();
+      llvm::sys::fs::remove(temporary);
+      return;
+    }
+  }
+  if (llvm::sys::fs::rename(temporary, directory + "/" + key + ".bc"))
+    llvm::sys::fs::remove(temporary);
+}
+
+} // namespace backend
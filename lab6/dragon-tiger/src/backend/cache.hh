@@ -0,0 +1,47 @@
+#ifndef CACHE_HH
+#define CACHE_HH
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+namespace backend {
+
+// Cache of optimized modules on disk, so that compiling a source file
+// again with the same options skips every phase up to code generation.
+//
+// Entries are bitcode files named after a hash of the source file, of
+// the options and of the dtiger build, so that rebuilding dtiger
+// invalidates them. They are written to a temporary file which is then
+// renamed, so that concurrent dtiger processes sharing a directory
+// never see partial entries and need no lock.
+class Cache {
+  std::string directory;
+
+public:
+  explicit Cache(const std::string &directory);
+
+  // Compute the key of a source file compiled with the given options,
+  // which must describe everything that changes the generated module,
+  // and linked with the given bitcode files. The contents of the files
+  // are part of the key. Return an empty key if a file cannot be read.
+  std::string key(const std::string &input_file,
+                  const std::vector<std::string> &linked_files,
+                  const std::string &options) const;
+
+  // Load the module cached for the given key, or return nullptr if
+  // there is none.
+  std::unique_ptr<llvm::Module> load(const std::string &key,
+                                     llvm::LLVMContext &context) const;
+
+  // Store a module for the given key. Failing to do so is not an error,
+  // as the entry will be recomputed next time.
+  void store(const std::string &key, const llvm::Module &module) const;
+};
+
+} // namespace backend
+
+#endif // CACHE_HH
@@ -0,0 +1,96 @@
+#include <mutex>
+
+#include "emitter.hh"
+#include "../utils/errors.hh"
+
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+
+namespace backend {
+
+namespace {
+
+llvm::CodeGenOpt::Level codegen_level(unsigned opt_level) {
+  switch (opt_level) {
+  case 0:
+    return llvm::CodeGenOpt::None;
+  case 1:
+    return llvm::CodeGenOpt::Less;
+  case 2:
+    return llvm::CodeGenOpt::Default;
+  default:
+    return llvm::CodeGenOpt::Aggressive;
+  }
+}
+
+} // namespace
+
+void emit_object(llvm::Module &module, const std::string &filename,
+                 unsigned opt_level) {
+  // Objects may be emitted from several threads at once.
+  static std::once_flag initialized;
+  std::call_once(initialized, []() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+  });
+
+  const std::string triple = llvm::sys::getDefaultTargetTriple();
+  std::string error;
+  const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+  if (!target)
+    utils::error("cannot find a target for " + triple + ": " + error);
+
+  // Objects are built as position independent code so that they can
+  // be linked into PIE executables, as the compile script used to do.
+  std::unique_ptr<llvm::TargetMachine> machine(target->createTargetMachine(
+      triple, "generic", "", llvm::TargetOptions(), llvm::Reloc::PIC_,
+      llvm::CodeModel::Default, codegen_level(opt_level)));
+  module.setTargetTriple(triple);
+  module.setDataLayout(machine->createDataLayout());
+
+  std::error_code ec;
+  llvm::raw_fd_ostream out(filename, ec, llvm::sys::fs::F_None);
+  if (ec)
+    utils::error("cannot open " + filename + ": " + ec.message());
+
+  llvm::legacy::PassManager passes;
+  if (machine->addPassesToEmitFile(passes, out,
+                                   llvm::TargetMachine::CGFT_ObjectFile))
+    utils::error("the target cannot emit object files");
+  passes.run(module);
+  out.flush();
+}
+
+void emit_executable(llvm::Module &module, const std::string &filename,
+                     unsigned opt_level) {
+  llvm::SmallString<128> object;
+  if (std::error_code ec =
+          llvm::sys::fs::createTemporaryFile("dtiger", "o", object))
+    utils::error("cannot create a temporary object file: " + ec.message());
+  emit_object(module, std::string(object.str()), opt_level);
+
+  // Let the C compiler driver find the startup files and the C
+  // library, as the compile script used to do.
+  llvm::ErrorOr<std::string> cc = llvm::sys::findProgramByName(TIGER_CC);
+  if (!cc)
+    utils::error(std::string("cannot find ") + TIGER_CC);
+  const char *args[] = {cc->c_str(),    "-Wl,--gc-sections", "-o",
+                        filename.c_str(), object.c_str(),     TIGER_RUNTIME,
+                        nullptr};
+  std::string message;
+  const int status =
+      llvm::sys::ExecuteAndWait(*cc, args, nullptr, nullptr, 0, 0, &message);
+  llvm::sys::fs::remove(object);
+  if (status != 0)
+    utils::error("cannot link " + filename +
+                 (message.empty() ? "" : ": " + message));
+}
+
+} // namespace backend
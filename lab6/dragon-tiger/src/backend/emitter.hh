@@ -0,0 +1,21 @@
+#ifndef EMITTER_HH
+#define EMITTER_HH
+
+#include <string>
+
+#include "llvm/IR/Module.h"
+
+namespace backend {
+
+// Compile a module into a native object file for the host.
+void emit_object(llvm::Module &module, const std::string &filename,
+                 unsigned opt_level);
+
+// Compile a module into a native executable for the host, linking
+// it with the Tiger runtime library.
+void emit_executable(llvm::Module &module, const std::string &filename,
+                     unsigned opt_level);
+
+} // namespace backend
+
+#endif // EMITTER_HH
@@ -0,0 +1,82 @@
+#include <mutex>
+
+#include "jit.hh"
+#include "../runtime/posix/runtime.h"
+#include "../utils/errors.hh"
+
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/TargetSelect.h"
+
+namespace backend {
+
+namespace {
+
+// Make the runtime primitives linked into dtiger visible to the JIT
+// symbol resolver. Registering them explicitly avoids having to
+// export every symbol of the dtiger executable.
+void register_runtime() {
+  static const struct {
+    const char *name;
+    void *address;
+  } primitives[] = {
+      {"__print_err", reinterpret_cast<void *>(&__print_err)},
+      {"__print", reinterpret_cast<void *>(&__print)},
+      {"__print_int", reinterpret_cast<void *>(&__print_int)},
+      {"__flush", reinterpret_cast<void *>(&__flush)},
+      {"__getchar", reinterpret_cast<void *>(&__getchar)},
+      {"__getline", reinterpret_cast<void *>(&__getline)},
+      {"__readall", reinterpret_cast<void *>(&__readall)},
+      {"__ord", reinterpret_cast<void *>(&__ord)},
+      {"__chr", reinterpret_cast<void *>(&__chr)},
+      {"__size", reinterpret_cast<void *>(&__size)},
+      {"__substring", reinterpret_cast<void *>(&__substring)},
+      {"__concat", reinterpret_cast<void *>(&__concat)},
+      {"__strcmp", reinterpret_cast<void *>(&__strcmp)},
+      {"__streq", reinterpret_cast<void *>(&__streq)},
+      {"__not", reinterpret_cast<void *>(&__not)},
+      {"__exit", reinterpret_cast<void *>(&__exit)},
+  };
+  for (auto &primitive : primitives)
+    llvm::sys::DynamicLibrary::AddSymbol(primitive.name, primitive.address);
+}
+
+} // namespace
+
+std::unique_ptr<llvm::ExecutionEngine>
+create_engine(std::unique_ptr<llvm::Module> module) {
+  static std::once_flag initialized;
+  std::call_once(initialized, []() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    register_runtime();
+  });
+
+  std::string error;
+  std::unique_ptr<llvm::ExecutionEngine> engine(
+      llvm::EngineBuilder(std::move(module))
+          .setEngineKind(llvm::EngineKind::JIT)
+          .setErrorStr(&error)
+          .create());
+  if (!engine)
+    utils::error("cannot create the JIT engine: " + error);
+  engine->finalizeObject();
+  return engine;
+}
+
+int run(std::unique_ptr<llvm::Module> module) {
+  std::unique_ptr<llvm::ExecutionEngine> engine =
+      create_engine(std::move(module));
+
+  auto const main = reinterpret_cast<int32_t (*)()>(
+      engine->getFunctionAddress("main"));
+  if (!main)
+    utils::error("cannot find main in the generated module");
+  const int32_t status = main();
+  // The runtime buffers the program output.
+  __flush();
+  return status;
+}
+
+} // namespace backend
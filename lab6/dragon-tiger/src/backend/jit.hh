@@ -0,0 +1,25 @@
+#ifndef JIT_HH
+#define JIT_HH
+
+#include <memory>
+
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/IR/Module.h"
+
+namespace backend {
+
+// Compile the given module in memory, resolving the runtime primitives
+// to those linked into dtiger. The module context must outlive the
+// returned engine. This can be called from any thread.
+std::unique_ptr<llvm::ExecutionEngine>
+create_engine(std::unique_ptr<llvm::Module> module);
+
+// Compile the given module in memory and run its main function.
+// The runtime primitives are those linked into dtiger itself, so
+// no external toolchain is involved. The module context must outlive
+// the call. Return the exit status of the Tiger program.
+int run(std::unique_ptr<llvm::Module> module);
+
+} // namespace backend
+
+#endif // JIT_HH
@@ -0,0 +1,37 @@
+#include "linker.hh"
+#include "../utils/errors.hh"
+
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/SourceMgr.h"
+
+namespace backend {
+
+std::string runtime_bitcode_file(const std::string &filename) {
+  return filename.empty() ? TIGER_RUNTIME_BC : filename;
+}
+
+void link_runtime(llvm::Module &module, const std::string &filename) {
+  const std::string file = runtime_bitcode_file(filename);
+  llvm::SMDiagnostic diagnostic;
+  std::unique_ptr<llvm::Module> runtime =
+      llvm::parseIRFile(file, diagnostic, module.getContext());
+  if (!runtime)
+    utils::error("cannot load the runtime from " + file + ": " +
+                 diagnostic.getMessage().str());
+
+  // The runtime was compiled for the host, as the program will be.
+  if (module.getTargetTriple().empty()) {
+    module.setTargetTriple(runtime->getTargetTriple());
+    module.setDataLayout(runtime->getDataLayout());
+  }
+
+  if (llvm::Linker::linkModules(module, std::move(runtime)))
+    utils::error("cannot link the runtime from " + file);
+
+  for (auto &function : module)
+    if (!function.isDeclaration() && function.getName() != "main")
+      function.setLinkage(llvm::GlobalValue::InternalLinkage);
+}
+
+} // namespace backend
@@ -0,0 +1,22 @@
+#ifndef LINKER_HH
+#define LINKER_HH
+
+#include <string>
+
+#include "llvm/IR/Module.h"
+
+namespace backend {
+
+// Link the runtime, compiled to LLVM bitcode, into the module, so
+// that the optimizer can inline the primitives and remove the unused
+// ones. Every function but main gets internal linkage. The default
+// runtime bitcode built with dtiger is used if filename is empty.
+void link_runtime(llvm::Module &module, const std::string &filename);
+
+// Name of the runtime bitcode file which link_runtime loads for the
+// given filename.
+std::string runtime_bitcode_file(const std::string &filename);
+
+} // namespace backend
+
+#endif // LINKER_HH
@@ -0,0 +1,38 @@
+#include "optimizer.hh"
+
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+
+namespace backend {
+
+void optimize(llvm::Module &module, unsigned level) {
+  if (level == 0)
+    return;
+
+  // The builder gives us the same pipelines as opt and clang:
+  // SROA (which promotes the allocas created by the code generator
+  // into registers), instcombine, GVN, LICM and the loop passes.
+  // Inner Tiger functions all have internal linkage, so the inliner
+  // is free to get rid of the small ones completely.
+  llvm::PassManagerBuilder builder;
+  builder.OptLevel = level;
+  builder.SizeLevel = 0;
+  builder.Inliner = llvm::createFunctionInliningPass(level, 0);
+  builder.LoopVectorize = level > 2;
+  builder.SLPVectorize = level > 2;
+
+  llvm::legacy::FunctionPassManager function_passes(&module);
+  llvm::legacy::PassManager module_passes;
+  builder.populateFunctionPassManager(function_passes);
+  builder.populateModulePassManager(module_passes);
+
+  function_passes.doInitialization();
+  for (llvm::Function &function : module)
+    function_passes.run(function);
+  function_passes.doFinalization();
+
+  module_passes.run(module);
+}
+
+} // namespace backend
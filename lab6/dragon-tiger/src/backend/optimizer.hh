@@ -0,0 +1,15 @@
+#ifndef OPTIMIZER_HH
+#define OPTIMIZER_HH
+
+#include "llvm/IR/Module.h"
+
+namespace backend {
+
+// Run the optimization pipeline corresponding to the given level
+// (0 to 3, as in -O0 to -O3) on a whole module. Level 0 leaves the
+// module untouched.
+void optimize(llvm::Module &module, unsigned level);
+
+} // namespace backend
+
+#endif // OPTIMIZER_HH
@@ -0,0 +1,26 @@
+#include "output.hh"
+#include "../utils/errors.hh"
+
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace backend {
+
+void write_ir(const llvm::Module &module, const std::string &filename) {
+  std::error_code ec;
+  llvm::raw_fd_ostream out(filename, ec, llvm::sys::fs::F_Text);
+  if (ec)
+    utils::error("cannot open " + filename + ": " + ec.message());
+  out << module;
+}
+
+void write_bitcode(const llvm::Module &module, const std::string &filename) {
+  std::error_code ec;
+  llvm::raw_fd_ostream out(filename, ec, llvm::sys::fs::F_None);
+  if (ec)
+    utils::error("cannot open " + filename + ": " + ec.message());
+  llvm::WriteBitcodeToFile(&module, out);
+}
+
+} // namespace backend
@@ -0,0 +1,21 @@
+#ifndef OUTPUT_HH
+#define OUTPUT_HH
+
+#include <string>
+
+#include "llvm/IR/Module.h"
+
+namespace backend {
+
+// Print a module as textual IR into a file ("-" is the standard
+// output). The text is streamed as it is produced.
+void write_ir(const llvm::Module &module, const std::string &filename);
+
+// Write a module as LLVM bitcode into a file ("-" is the standard
+// output). Bitcode is much faster to write and to load back than
+// the textual form.
+void write_bitcode(const llvm::Module &module, const std::string &filename);
+
+} // namespace backend
+
+#endif // OUTPUT_HH
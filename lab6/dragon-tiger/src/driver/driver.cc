@@ -1,16 +1,174 @@
+#include <algorithm>
+#include <atomic>
 #include <boost/program_options.hpp>
+#include <cstdlib>
 #include <iostream>
+#include <mutex>
+#include <set>
+#include <thread>
 
 #include "../ast/ast_dumper.hh"
 #include "../ast/binder.hh"
 #include "../ast/escaper.hh"
 #include "../ast/type_checker.hh"
+#include "../backend/cache.hh"
+#include "../backend/emitter.hh"
+#include "../backend/jit.hh"
+#include "../backend/linker.hh"
+#include "../backend/optimizer.hh"
+#include "../backend/output.hh"
 #include "../parser/parser_driver.hh"
 #include "../irgen/irgen.hh"
 #include "../utils/errors.hh"
+#include "../vm/compiler.hh"
+#include "../vm/interpreter.hh"
+#include "stats.hh"
+
+namespace {
+
+// Name of the object file built from a source file when no output
+// file is given: the source file base name with a .o extension.
+std::string object_file_name(const std::string &input_file) {
+  if (input_file == "-")
+    return "a.o";
+  std::string name = input_file.substr(input_file.find_last_of('/') + 1);
+  const std::string::size_type dot = name.find_last_of('.');
+  if (dot != std::string::npos && dot != 0)
+    name.erase(dot);
+  return name + ".o";
+}
+
+// Options of the compilation of each file in batch mode.
+struct BatchOptions {
+  unsigned opt_level;
+  bool runtime_bc;
+  std::string runtime_bc_file;
+  std::string cache_dir;
+  // Description of the options above and files they link in, for the
+  // cache keys.
+  std::string module_options;
+  std::vector<std::string> module_files;
+  bool trace_lexer;
+  bool trace_parser;
+};
+
+// The lexer keeps its state in globals, so files are parsed one at a
+// time. An error in the lexer leaves that state behind, so no file is
+// parsed after a failed parse.
+std::mutex parse_lock;
+bool parse_failed = false;
+
+// Compile a source file into its own object file. Files can be compiled
+// concurrently, since each compilation has its own LLVM context, owned
+// by its IR generator or created for a cached module. Errors are thrown
+// as utils::Error, see compile_objects.
+void compile_object(const std::string &input_file,
+                    const BatchOptions &options) {
+  // The module must be destroyed before the context it belongs to.
+  llvm::LLVMContext cached_context;
+  irgen::IRGenerator ir_generator;
+  std::unique_ptr<llvm::Module> module;
+  std::unique_ptr<backend::Cache> cache;
+  std::string cache_key;
+  if (!options.cache_dir.empty()) {
+    cache.reset(new backend::Cache(options.cache_dir));
+    cache_key = cache->key(input_file, options.module_files,
+                           options.module_options);
+    if (!cache_key.empty())
+      module = cache->load(cache_key, cached_context);
+  }
+
+  // Locations in the AST refer to the file name held by the parser
+  // driver, which must outlive it.
+  ParserDriver parser_driver(options.trace_lexer, options.trace_parser);
+  if (!module) {
+    {
+      std::lock_guard<std::mutex> guard(parse_lock);
+      // The failed parse has already made the whole compilation fail.
+      if (parse_failed)
+        return;
+      parse_failed = true;
+      if (!parser_driver.parse(input_file))
+        utils::error("parser failed on " + input_file);
+      parse_failed = false;
+    }
+    ast::binder::Binder binder;
+    FunDecl *main = binder.analyze_program(*parser_driver.result_ast);
+    ast::escaper::Escaper escaper;
+    main->accept(escaper);
+    ast::type_checker::TypeChecker type_checker;
+    main->accept(type_checker);
+
+    ir_generator.generate_program(main);
+    delete parser_driver.result_ast;
+    if (options.runtime_bc)
+      backend::link_runtime(ir_generator.get_module(),
+                            options.runtime_bc_file);
+    backend::optimize(ir_generator.get_module(), options.opt_level);
+    module = ir_generator.release_module();
+    if (cache && !cache_key.empty())
+      cache->store(cache_key, *module);
+  }
+
+  backend::emit_object(*module, object_file_name(input_file),
+                       options.opt_level);
+}
+
+// Compile several source files into object files, using the given
+// number of threads.
+//
+// An error in a file must not exit the process while other threads
+// are still compiling, so each thread catches its errors and stops
+// taking new files. Once every thread is done, the errors are reported
+// and dtiger exits from the main thread.
+void compile_objects(const std::vector<std::string> &input_files,
+                     const BatchOptions &options, unsigned jobs) {
+  std::set<std::string> objects;
+  for (auto &input_file : input_files)
+    if (!objects.insert(object_file_name(input_file)).second)
+      utils::error("several input files would be compiled into " +
+                   object_file_name(input_file));
+
+  std::atomic<size_t> next(0);
+  std::atomic<bool> failed(false);
+  std::vector<std::string> errors(input_files.size());
+  auto work = [&]() {
+    utils::ThrowErrors throw_errors;
+    for (size_t i; !failed && (i = next++) < input_files.size();) {
+      try {
+        compile_object(input_files[i], options);
+      } catch (const utils::Error &e) {
+        errors[i] = e.what();
+        failed = true;
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned j = 1; j < std::min<size_t>(jobs, input_files.size()); j++)
+    workers.emplace_back(work);
+  work();
+  for (auto &worker : workers)
+    worker.join();
+
+  if (failed) {
+    for (auto &error : errors)
+      if (!error.empty())
+        utils::non_fatal_error(error);
+    exit(EXIT_FAILURE);
+  }
+}
+
+} // namespace
 
 int main(int argc, char **argv) {
   std::string output_file;
+  std::string bitcode_file;
+  std::string stats_file;
+  std::string runtime_bc_file;
+  std::string cache_dir;
+  unsigned opt_level;
+  unsigned jit_threshold;
+  unsigned jobs;
   std::vector<std::string> input_files;
   namespace po = boost::program_options;
   po::options_description options("Options");
@@ -18,16 +176,40 @@ int main(int argc, char **argv) {
   ("help,h", "describe arguments")
   ("dump-ast", "dump the parsed AST")
   ("dump-ir", "dump the generated IR")
+  ("emit-bc", po::value(&bitcode_file), "write the generated IR as bitcode")
   ("bind,b", "run the binder on the parsed AST")
   ("type,t", "run the type checker on the parsed AST")
   ("irgen,i", "run the LLVM IR code generator")
+  ("run,r", "compile the program in memory and run it")
+  ("vm", "compile the program to bytecode and run it in the virtual "
+   "machine")
+  ("dump-bytecode", "dump the generated bytecode")
+  ("jit-threshold", po::value(&jit_threshold)->default_value(1000),
+   "number of calls after which the virtual machine compiles a function "
+   "to native code (0 to never do it)")
+  ("compile,c", "emit a native object file instead of an executable")
+  ("output,o", po::value(&output_file), "name of the object or executable")
+  ("jobs,j", po::value(&jobs)->default_value(0),
+   "number of files compiled in parallel when several input files are "
+   "given with -c (default: one per processor)")
+  ("optimize,O", po::value(&opt_level)->default_value(0),
+   "optimization level (0 to 3)")
+  ("runtime-bc", po::value(&runtime_bc_file)->implicit_value(""),
+   "link the runtime bitcode (from the given file, or the one built "
+   "with dtiger) into the program before optimizing it")
+  ("cache-dir", po::value(&cache_dir),
+   "cache the optimized IR of compiled programs in the given directory "
+   "(default: $DTIGER_CACHE_DIR, if set)")
+  ("time-passes", "report time and memory used by each phase")
+  ("stats-json", po::value(&stats_file),
+   "write the phase report as JSON to the given file")
   ("trace-parser", "enable parser traces")
   ("trace-lexer", "enable lexer traces")
   ("verbose,v", "be verbose")
-  ("input-file", po::value(&input_files), "input Tiger file");
+  ("input-file", po::value(&input_files), "input Tiger files");
 
   po::positional_options_description positional;
-  positional.add("input-file", 1);
+  positional.add("input-file", -1);
 
   po::variables_map vm;
   po::store(po::command_line_parser(argc, argv)
@@ -42,35 +224,212 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  if (input_files.size() != 1) {
-    utils::error("usage: dtiger [options] input-file");
+  if (input_files.empty()) {
+    utils::error("usage: dtiger [options] input-file...");
+  }
+
+  if (opt_level > 3) {
+    utils::error("optimization level must be between 0 and 3");
   }
 
+  // The JIT resolves primitives to the runtime linked into dtiger.
+  if (vm.count("runtime-bc") && vm.count("run")) {
+    utils::error("--runtime-bc cannot be used with --run");
+  }
+
+  if (cache_dir.empty() && getenv("DTIGER_CACHE_DIR"))
+    cache_dir = getenv("DTIGER_CACHE_DIR");
+  const std::string module_options =
+      "O" + std::to_string(opt_level) +
+      (vm.count("runtime-bc") ? " runtime-bc" : "");
+  std::vector<std::string> module_files;
+  if (vm.count("runtime-bc"))
+    module_files.push_back(backend::runtime_bitcode_file(runtime_bc_file));
+
+  // Several input files are compiled into one object file each.
+  if (input_files.size() > 1) {
+    if (!vm.count("compile"))
+      utils::error("several input files can only be compiled with -c");
+    for (const char *option :
+         {"output", "emit-bc", "run", "vm", "dump-ast", "dump-ir",
+          "dump-bytecode", "time-passes", "stats-json"})
+      if (vm.count(option))
+        utils::error(std::string("--") + option +
+                     " cannot be used with several input files");
+    BatchOptions batch_options;
+    batch_options.opt_level = opt_level;
+    batch_options.runtime_bc = vm.count("runtime-bc") > 0;
+    batch_options.runtime_bc_file = runtime_bc_file;
+    batch_options.cache_dir = cache_dir;
+    batch_options.module_options = module_options;
+    batch_options.module_files = module_files;
+    batch_options.trace_lexer = vm.count("trace-lexer") > 0;
+    batch_options.trace_parser = vm.count("trace-parser") > 0;
+    if (!jobs)
+      jobs = std::max(1u, std::thread::hardware_concurrency());
+    compile_objects(input_files, batch_options, jobs);
+    return 0;
+  }
+
+  stats::Report report(vm.count("time-passes") || vm.count("stats-json"));
+  auto output_report = [&]() {
+    if (vm.count("time-passes"))
+      report.print(std::cerr);
+    if (vm.count("stats-json"))
+      report.write_json(stats_file);
+  };
+
+  const bool irgen = vm.count("irgen") || vm.count("run") ||
+                     vm.count("compile") || vm.count("output") ||
+                     vm.count("emit-bc");
+  const bool bytecode = vm.count("vm") || vm.count("dump-bytecode");
+  if (vm.count("vm") && irgen) {
+    utils::error("--vm cannot be used with LLVM code generation options");
+  }
+  int status = 0;
+
+  // A cached module replaces every phase up to the optimizer, so the
+  // cache is only used when nothing else needs the AST.
+  std::unique_ptr<backend::Cache> cache;
+  std::string cache_key;
+  llvm::LLVMContext cached_context;
+  std::unique_ptr<llvm::Module> cached_module;
+  if (irgen && !bytecode && !cache_dir.empty() && !vm.count("dump-ast") &&
+      input_files[0] != "-") {
+    report.begin("cache");
+    cache.reset(new backend::Cache(cache_dir));
+    cache_key = cache->key(input_files[0], module_files, module_options);
+    if (!cache_key.empty())
+      cached_module = cache->load(cache_key, cached_context);
+    report.end();
+    if (report.enabled())
+      report.count("hits", cached_module ? 1 : 0);
+  }
+  const bool cache_hit = cached_module != nullptr;
+
   ParserDriver parser_driver = ParserDriver(vm.count("trace-lexer"), vm.count("trace-parser"));
 
-  if (!parser_driver.parse(input_files[0])) {
-    utils::error("parser failed");
+  if (!cache_hit) {
+    report.begin("parse");
+    if (!parser_driver.parse(input_files[0])) {
+      utils::error("parser failed");
+    }
+    report.end();
+    if (report.enabled()) {
+      report.count("nodes", stats::count_nodes(*parser_driver.result_ast));
+      report.count("symbols", utils::Symbol::table_size());
+    }
   }
 
   FunDecl *main = nullptr;
-  if (vm.count("bind") || vm.count("type") || vm.count("irgen")) {
+  if (!cache_hit &&
+      (vm.count("bind") || vm.count("type") || irgen || bytecode)) {
+    report.begin("bind");
     ast::binder::Binder binder;
     main = binder.analyze_program(*parser_driver.result_ast);
+    report.end();
+    if (report.enabled()) {
+      report.count("nodes", stats::count_nodes(*main));
+      report.count("symbols", utils::Symbol::table_size());
+    }
+
+    report.begin("escape");
     ast::escaper::Escaper escaper;
     main->accept(escaper);
+    report.end();
   }
 
-  if (vm.count("type") || vm.count("irgen")) {
+  if (!cache_hit && (vm.count("type") || irgen || bytecode)) {
+    report.begin("type");
     ast::type_checker::TypeChecker type_checker;
     main->accept(type_checker);
+    report.end();
+  }
+
+  vm::Program program;
+  if (bytecode) {
+    report.begin("bytecode");
+    program = vm::Compiler().compile_program(*main);
+    report.end();
+    if (report.enabled()) {
+      report.count("functions", program.functions.size());
+      report.count("words", program.code.size());
+    }
+
+    if (vm.count("dump-bytecode")) {
+      program.dump(std::cout);
+    }
   }
 
-  if (vm.count("irgen")) {
+  if (irgen) {
     irgen::IRGenerator ir_generator;
-    ir_generator.generate_program(main);
+    // The module either comes from the cache or belongs to the context
+    // of the IR generator.
+    std::unique_ptr<llvm::Module> module = std::move(cached_module);
+    if (!module) {
+      report.begin("irgen");
+      ir_generator.generate_program(main);
+      report.end();
+      if (report.enabled()) {
+        report.count("functions", ir_generator.get_module().size());
+        report.count("instructions",
+                     stats::count_instructions(ir_generator.get_module()));
+      }
+
+      if (vm.count("runtime-bc")) {
+        report.begin("link");
+        backend::link_runtime(ir_generator.get_module(), runtime_bc_file);
+        report.end();
+      }
+
+      report.begin("optimize");
+      backend::optimize(ir_generator.get_module(), opt_level);
+      report.end();
+      if (report.enabled()) {
+        report.count("functions", ir_generator.get_module().size());
+        report.count("instructions",
+                     stats::count_instructions(ir_generator.get_module()));
+      }
+
+      module = ir_generator.release_module();
+      if (cache && !cache_key.empty())
+        cache->store(cache_key, *module);
+    }
 
     if (vm.count("dump-ir")) {
-      ir_generator.print_ir(&std::cout);
+      backend::write_ir(*module, "-");
+    }
+
+    if (vm.count("emit-bc")) {
+      backend::write_bitcode(*module, bitcode_file);
+    }
+
+    if (vm.count("compile")) {
+      if (output_file.empty())
+        output_file = object_file_name(input_files[0]);
+      report.begin("codegen");
+      backend::emit_object(*module, output_file, opt_level);
+      report.end();
+    } else if (!output_file.empty()) {
+      report.begin("codegen");
+      backend::emit_executable(*module, output_file, opt_level);
+      report.end();
+    }
+
+    // The report is written before running the program, whose own
+    // execution is not a compilation phase.
+    output_report();
+
+    if (vm.count("run")) {
+      status = backend::run(std::move(module));
+    }
+  }
+
+  if (!irgen) {
+    output_report();
+
+    if (vm.count("vm")) {
+      status = vm::run(program, jit_threshold);
     }
   }
 
@@ -82,6 +441,7 @@ int main(int argc, char **argv) {
       parser_driver.result_ast->accept(dumper);
     dumper.nl();
   }
-  delete parser_driver.result_ast;
-  return 0;
+  if (!cache_hit)
+    delete parser_driver.result_ast;
+  return status;
 }
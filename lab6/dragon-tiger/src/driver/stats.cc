@@ -0,0 +1,162 @@
+#include <fstream>
+#include <iomanip>
+#include <sys/resource.h>
+
+#include "stats.hh"
+#include "../utils/errors.hh"
+
+#include "llvm/IR/Module.h"
+
+using namespace ast;
+
+namespace {
+
+long peak_rss_kb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+class NodeCounter : public ConstASTVisitor {
+public:
+  uint64_t count = 0;
+
+  virtual void visit(const IntegerLiteral &) { count++; }
+  virtual void visit(const StringLiteral &) { count++; }
+  virtual void visit(const BinaryOperator &op) {
+    count++;
+    op.get_left().accept(*this);
+    op.get_right().accept(*this);
+  }
+  virtual void visit(const Sequence &seq) {
+    count++;
+    for (auto expr : seq.get_exprs())
+      expr->accept(*this);
+  }
+  virtual void visit(const Let &let) {
+    count++;
+    for (auto decl : let.get_decls())
+      decl->accept(*this);
+    let.get_sequence().accept(*this);
+  }
+  virtual void visit(const Identifier &) { count++; }
+  virtual void visit(const IfThenElse &ite) {
+    count++;
+    ite.get_condition().accept(*this);
+    ite.get_then_part().accept(*this);
+    ite.get_else_part().accept(*this);
+  }
+  virtual void visit(const VarDecl &decl) {
+    count++;
+    if (auto expr = decl.get_expr())
+      expr->accept(*this);
+  }
+  virtual void visit(const FunDecl &decl) {
+    count++;
+    for (auto param : decl.get_params())
+      param->accept(*this);
+    if (auto expr = decl.get_expr())
+      expr->accept(*this);
+  }
+  virtual void visit(const FunCall &call) {
+    count++;
+    for (auto arg : call.get_args())
+      arg->accept(*this);
+  }
+  virtual void visit(const WhileLoop &loop) {
+    count++;
+    loop.get_condition().accept(*this);
+    loop.get_body().accept(*this);
+  }
+  virtual void visit(const ForLoop &loop) {
+    count++;
+    loop.get_variable().accept(*this);
+    loop.get_high().accept(*this);
+    loop.get_body().accept(*this);
+  }
+  virtual void visit(const Break &) { count++; }
+  virtual void visit(const Assign &assign) {
+    count++;
+    assign.get_lhs().accept(*this);
+    assign.get_rhs().accept(*this);
+  }
+};
+
+} // namespace
+
+namespace stats {
+
+void Report::begin(const std::string &phase) {
+  if (!is_enabled)
+    return;
+  phases.push_back({phase, 0, 0, {}});
+  start_peak_rss_kb = peak_rss_kb();
+  start_time = std::chrono::steady_clock::now();
+}
+
+void Report::end() {
+  if (!is_enabled)
+    return;
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start_time;
+  phases.back().seconds = elapsed.count();
+  phases.back().peak_rss_delta_kb = peak_rss_kb() - start_peak_rss_kb;
+}
+
+void Report::count(const std::string &name, uint64_t value) {
+  if (is_enabled && !phases.empty())
+    phases.back().counters.push_back({name, value});
+}
+
+void Report::print(std::ostream &out) const {
+  double total = 0;
+  out << "===--- dtiger phase report ---===\n"
+      << std::left << std::setw(12) << "phase" << std::right << std::setw(12)
+      << "time (s)" << std::setw(16) << "peak RSS +KiB"
+      << "  counters\n";
+  for (auto &phase : phases) {
+    total += phase.seconds;
+    out << std::left << std::setw(12) << phase.name << std::right
+        << std::fixed << std::setprecision(6) << std::setw(12)
+        << phase.seconds << std::setw(16) << phase.peak_rss_delta_kb << " ";
+    for (auto &counter : phase.counters)
+      out << " " << counter.first << "=" << counter.second;
+    out << "\n";
+  }
+  out << std::left << std::setw(12) << "total" << std::right << std::setw(12)
+      << total << std::setw(16) << peak_rss_kb() << "  (peak RSS KiB)\n";
+}
+
+void Report::write_json(const std::string &filename) const {
+  std::ofstream out(filename);
+  if (!out)
+    utils::error("cannot open " + filename);
+  out << "{\n  \"peak_rss_kb\": " << peak_rss_kb() << ",\n  \"phases\": [";
+  for (size_t i = 0; i < phases.size(); i++) {
+    const Phase &phase = phases[i];
+    out << (i ? ",\n" : "\n") << "    {\"name\": \"" << phase.name
+        << "\", \"seconds\": " << std::fixed << std::setprecision(6)
+        << phase.seconds
+        << ", \"peak_rss_delta_kb\": " << phase.peak_rss_delta_kb;
+    for (auto &counter : phase.counters)
+      out << ", \"" << counter.first << "\": " << counter.second;
+    out << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+uint64_t count_nodes(const Node &node) {
+  NodeCounter counter;
+  node.accept(counter);
+  return counter.count;
+}
+
+uint64_t count_instructions(const llvm::Module &module) {
+  uint64_t count = 0;
+  for (auto &function : module)
+    for (auto &block : function)
+      count += block.size();
+  return count;
+}
+
+} // namespace stats
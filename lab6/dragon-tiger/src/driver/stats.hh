@@ -0,0 +1,60 @@
+#ifndef STATS_HH
+#define STATS_HH
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../ast/nodes.hh"
+
+namespace llvm {
+class Module;
+} // namespace llvm
+
+namespace stats {
+
+// Record the wall time and the peak resident set size growth of each
+// compilation phase, together with named counters describing the
+// program at the end of the phase. When the report is disabled,
+// begin() and end() do nothing.
+class Report {
+  struct Phase {
+    std::string name;
+    double seconds;
+    long peak_rss_delta_kb;
+    std::vector<std::pair<std::string, uint64_t>> counters;
+  };
+
+  bool is_enabled;
+  std::vector<Phase> phases;
+  std::chrono::steady_clock::time_point start_time;
+  long start_peak_rss_kb;
+
+public:
+  Report(bool enabled) : is_enabled(enabled) {}
+  bool enabled() const { return is_enabled; }
+
+  // Start and stop measuring a phase.
+  void begin(const std::string &phase);
+  void end();
+
+  // Attach a counter to the last measured phase.
+  void count(const std::string &name, uint64_t value);
+
+  // Output the report as a table or as a JSON document.
+  void print(std::ostream &out) const;
+  void write_json(const std::string &filename) const;
+};
+
+// Number of nodes in the AST rooted at node.
+uint64_t count_nodes(const ast::Node &node);
+
+// Number of IR instructions in the module.
+uint64_t count_instructions(const llvm::Module &module);
+
+} // namespace stats
+
+#endif // STATS_HH
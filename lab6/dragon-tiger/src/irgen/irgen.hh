@@ -104,6 +104,14 @@ public:
   // Print the generated IR.
   void print_ir(std::ostream *);
 
+  // Access the generated module.
+  llvm::Module &get_module() { return *Mod; }
+
+  // Give up the ownership of the generated module, for example
+  // to hand it to the JIT. The module still belongs to this
+  // generator's context, so the generator must outlive it.
+  std::unique_ptr<llvm::Module> release_module() { return std::move(Mod); }
+
   // Generate the IR corresponding to those AST nodes.
   // Those methods will return either nullptr when no
   // result is expected (a statement for example),
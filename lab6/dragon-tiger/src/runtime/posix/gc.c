@@ -0,0 +1,429 @@
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "gc.h"
+
+// The heap is made of chunks, each one divided into 8-byte granules.
+// An object is preceded by a one-granule header holding its size, and
+// the granule of every header is flagged in the chunk starts bitmap,
+// which allows finding the object containing any heap address.
+// Objects larger than a quarter of a chunk get a chunk of their own.
+//
+// Chunks are carved out of a single range of addresses, reserved when
+// the first chunk is needed and committed chunk by chunk, so that
+// gc_contains is a range check.
+
+#define GRANULE 8
+#define CHUNK_SIZE (1 << 20)
+#define LARGE_OBJECT (CHUNK_SIZE / 4)
+#define MIN_THRESHOLD (8 << 20)
+#define PAGE 4096
+
+#if UINTPTR_MAX > 0xffffffff
+#define HEAP_RESERVE ((size_t) 1 << 38)
+#else
+#define HEAP_RESERVE ((size_t) 1 << 30)
+#endif
+
+struct header {
+  uint32_t granules;
+  uint32_t has_pointers;
+};
+
+struct chunk {
+  char *base;
+  size_t granules;
+  uint64_t *starts;
+  uint64_t *marks;
+  int large;
+};
+
+// A free span, stored in place. Spans are linked by increasing address.
+struct span {
+  size_t granules;
+  struct span *next;
+};
+
+// A range of the reserved addresses which is not committed.
+struct range {
+  char *start;
+  size_t size;
+};
+
+char *gc_heap_start;
+size_t gc_heap_size;
+
+// The reserved addresses at or above heap_top have never been used.
+// Below it, the addresses of released chunks are kept in free_ranges,
+// sorted by address and coalesced.
+static char *heap_top;
+static char *heap_end;
+static struct range *free_ranges;
+static size_t free_range_count;
+static size_t free_range_capacity;
+
+// Chunks, sorted by address.
+static struct chunk **chunks;
+static size_t chunk_count;
+static size_t chunk_capacity;
+
+static struct span *free_spans;
+static char *bump;
+static char *limit;
+static struct chunk *bump_chunk;
+
+static size_t allocated_since_collection;
+static size_t threshold = MIN_THRESHOLD;
+
+// Objects marked but not scanned yet.
+static struct header **mark_stack;
+static size_t mark_stack_size;
+static size_t mark_stack_capacity;
+
+#ifdef __GLIBC__
+extern void *__libc_stack_end;
+#else
+static void *__libc_stack_end;
+
+__attribute__((constructor))
+static void init_stack_end(void) {
+  __libc_stack_end = __builtin_frame_address(0);
+}
+#endif
+
+__attribute__((noreturn))
+static void out_of_memory(void) {
+  fprintf(stderr, "out of memory\n");
+  exit(EXIT_FAILURE);
+}
+
+static inline int test_bit(const uint64_t *bitmap, size_t i) {
+  return (bitmap[i / 64] >> (i % 64)) & 1;
+}
+
+static inline void set_bit(uint64_t *bitmap, size_t i) {
+  bitmap[i / 64] |= (uint64_t) 1 << (i % 64);
+}
+
+static inline void clear_bit(uint64_t *bitmap, size_t i) {
+  bitmap[i / 64] &= ~((uint64_t) 1 << (i % 64));
+}
+
+// Index of the first set bit at or after i, or n if there is none.
+static size_t next_bit(const uint64_t *bitmap, size_t i, size_t n) {
+  while (i < n) {
+    uint64_t word = bitmap[i / 64] >> (i % 64);
+    if (word)
+      return i + __builtin_ctzll(word);
+    i = (i / 64 + 1) * 64;
+  }
+  return n;
+}
+
+// Index of the last set bit at or before i, or SIZE_MAX if there is none.
+static size_t previous_bit(const uint64_t *bitmap, size_t i) {
+  for (;;) {
+    uint64_t word = bitmap[i / 64] << (63 - i % 64);
+    if (word)
+      return i - __builtin_clzll(word);
+    if (i < 64)
+      return SIZE_MAX;
+    i = (i / 64) * 64 - 1;
+  }
+}
+
+static struct chunk *find_chunk(const char *p) {
+  size_t low = 0, high = chunk_count;
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    struct chunk *chunk = chunks[middle];
+    if (p < chunk->base)
+      high = middle;
+    else if (p >= chunk->base + chunk->granules * GRANULE)
+      low = middle + 1;
+    else
+      return chunk;
+  }
+  return NULL;
+}
+
+// Return size bytes of reserved addresses, taken from the first free
+// range large enough or else from the top of the heap.
+static char *take_range(size_t size) {
+  for (size_t i = 0; i < free_range_count; i++) {
+    struct range *range = &free_ranges[i];
+    if (range->size < size)
+      continue;
+    char *start = range->start;
+    range->start += size;
+    range->size -= size;
+    if (range->size == 0)
+      memmove(range, range + 1,
+              (--free_range_count - i) * sizeof(struct range));
+    return start;
+  }
+
+  if (!gc_heap_start) {
+    gc_heap_start = mmap(NULL, HEAP_RESERVE, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (gc_heap_start == MAP_FAILED) {
+      gc_heap_start = NULL;
+      out_of_memory();
+    }
+    heap_top = gc_heap_start;
+    heap_end = gc_heap_start + HEAP_RESERVE;
+  }
+  if ((size_t) (heap_end - heap_top) < size)
+    out_of_memory();
+  char *start = heap_top;
+  heap_top += size;
+  gc_heap_size = heap_top - gc_heap_start;
+  return start;
+}
+
+// Decommit the size bytes at start, and give their addresses back to
+// the free ranges, or to the top of the heap.
+static void release_range(char *start, size_t size) {
+  if (mmap(start, size, PROT_NONE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1,
+           0) == MAP_FAILED)
+    out_of_memory();
+
+  size_t i = 0;
+  while (i < free_range_count && free_ranges[i].start < start)
+    i++;
+  if (i > 0 && free_ranges[i - 1].start + free_ranges[i - 1].size == start) {
+    i--;
+    free_ranges[i].size += size;
+  } else {
+    if (free_range_count == free_range_capacity) {
+      free_range_capacity = free_range_capacity ? 2 * free_range_capacity : 16;
+      free_ranges =
+          realloc(free_ranges, free_range_capacity * sizeof(struct range));
+      if (!free_ranges)
+        out_of_memory();
+    }
+    memmove(&free_ranges[i + 1], &free_ranges[i],
+            (free_range_count++ - i) * sizeof(struct range));
+    free_ranges[i].start = start;
+    free_ranges[i].size = size;
+  }
+  if (i + 1 < free_range_count &&
+      free_ranges[i].start + free_ranges[i].size == free_ranges[i + 1].start) {
+    free_ranges[i].size += free_ranges[i + 1].size;
+    memmove(&free_ranges[i + 1], &free_ranges[i + 2],
+            (--free_range_count - i - 1) * sizeof(struct range));
+  }
+  if (i + 1 == free_range_count &&
+      free_ranges[i].start + free_ranges[i].size == heap_top) {
+    heap_top = free_ranges[i].start;
+    gc_heap_size = heap_top - gc_heap_start;
+    free_range_count--;
+  }
+}
+
+static struct chunk *new_chunk(size_t size, int large) {
+  char *base = take_range(size);
+  if (mprotect(base, size, PROT_READ | PROT_WRITE) != 0)
+    out_of_memory();
+  if (chunk_count == chunk_capacity) {
+    chunk_capacity = chunk_capacity ? 2 * chunk_capacity : 16;
+    chunks = realloc(chunks, chunk_capacity * sizeof(struct chunk *));
+    if (!chunks)
+      out_of_memory();
+  }
+
+  struct chunk *chunk = malloc(sizeof(struct chunk));
+  if (!chunk)
+    out_of_memory();
+  size_t i = chunk_count++;
+  while (i > 0 && chunks[i - 1]->base > base) {
+    chunks[i] = chunks[i - 1];
+    i--;
+  }
+  chunks[i] = chunk;
+  chunk->base = base;
+  chunk->granules = size / GRANULE;
+  chunk->large = large;
+  chunk->starts = calloc((chunk->granules + 63) / 64, sizeof(uint64_t));
+  chunk->marks = calloc((chunk->granules + 63) / 64, sizeof(uint64_t));
+  if (!chunk->starts || !chunk->marks)
+    out_of_memory();
+  return chunk;
+}
+
+// Release the chunk at index i of the chunk table.
+static void free_chunk(size_t i) {
+  struct chunk *chunk = chunks[i];
+  release_range(chunk->base, chunk->granules * GRANULE);
+  free(chunk->starts);
+  free(chunk->marks);
+  free(chunk);
+  memmove(&chunks[i], &chunks[i + 1], (--chunk_count - i) * sizeof *chunks);
+}
+
+static void push(struct header *object) {
+  if (mark_stack_size == mark_stack_capacity) {
+    mark_stack_capacity = mark_stack_capacity ? 2 * mark_stack_capacity : 256;
+    mark_stack =
+        realloc(mark_stack, mark_stack_capacity * sizeof(struct header *));
+    if (!mark_stack)
+      out_of_memory();
+  }
+  mark_stack[mark_stack_size++] = object;
+}
+
+// Mark the object containing address p, if any.
+static void mark_address(const char *p) {
+  if (!gc_contains(p))
+    return;
+  struct chunk *chunk = find_chunk(p);
+  if (!chunk)
+    return;
+  size_t granule = previous_bit(chunk->starts, (p - chunk->base) / GRANULE);
+  if (granule == SIZE_MAX || test_bit(chunk->marks, granule))
+    return;
+  struct header *object = (struct header *) (chunk->base + granule * GRANULE);
+  if (p >= (char *) object + object->granules * GRANULE)
+    return;
+  set_bit(chunk->marks, granule);
+  if (object->has_pointers)
+    push(object);
+}
+
+static void mark_range(const char *start, const char *end) {
+  const uintptr_t aligned =
+      ((uintptr_t) start + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+  for (char *const *p = (char *const *) aligned; (const char *) p < end; p++)
+    mark_address(*p);
+}
+
+__attribute__((noinline))
+static void mark_from_stack(void) {
+  mark_range(__builtin_frame_address(0), __libc_stack_end);
+  while (mark_stack_size > 0) {
+    struct header *object = mark_stack[--mark_stack_size];
+    mark_range((char *) (object + 1),
+               (char *) object + object->granules * GRANULE);
+  }
+}
+
+static void add_free_span(struct span ***last, char *start, size_t granules) {
+  // Spans too small to hold an object are lost until a neighbour dies.
+  if (granules < 2)
+    return;
+  struct span *span = (struct span *) start;
+  span->granules = granules;
+  span->next = NULL;
+  **last = span;
+  *last = &span->next;
+}
+
+static void sweep(void) {
+  struct span **last = &free_spans;
+  size_t live = 0;
+  free_spans = NULL;
+  bump = limit = NULL;
+  bump_chunk = NULL;
+
+  for (size_t c = 0; c < chunk_count;) {
+    struct chunk *chunk = chunks[c];
+    size_t live_in_chunk = 0;
+    size_t gap = 0;
+    size_t i = next_bit(chunk->starts, 0, chunk->granules);
+    while (i < chunk->granules) {
+      struct header *object = (struct header *) (chunk->base + i * GRANULE);
+      size_t end = i + object->granules;
+      if (test_bit(chunk->marks, i)) {
+        clear_bit(chunk->marks, i);
+        if (gap < i)
+          add_free_span(&last, chunk->base + gap * GRANULE, i - gap);
+        gap = end;
+        live_in_chunk += object->granules * GRANULE;
+      } else {
+        clear_bit(chunk->starts, i);
+      }
+      i = next_bit(chunk->starts, end, chunk->granules);
+    }
+
+    if (chunk->large && live_in_chunk == 0) {
+      // Dead large objects give their memory back to the system.
+      free_chunk(c);
+      continue;
+    }
+    if (!chunk->large && gap < chunk->granules)
+      add_free_span(&last, chunk->base + gap * GRANULE, chunk->granules - gap);
+    live += live_in_chunk;
+    c++;
+  }
+
+  allocated_since_collection = 0;
+  threshold = live > MIN_THRESHOLD ? live : MIN_THRESHOLD;
+}
+
+// Registers holding pointers are spilled into a jmp_buf on the stack
+// by setjmp. mark_from_stack is not inlined so that its frame, where
+// the scan starts, is below the jmp_buf.
+void gc_collect(void) {
+  jmp_buf registers;
+  setjmp(registers);
+  mark_from_stack();
+  sweep();
+}
+
+// Find room for granules granules in the free spans, and make the
+// remainder of the span the current bump region.
+static int refill(size_t granules) {
+  while (free_spans) {
+    struct span *span = free_spans;
+    free_spans = span->next;
+    if (span->granules >= granules) {
+      bump = (char *) span;
+      limit = bump + span->granules * GRANULE;
+      bump_chunk = find_chunk(bump);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void *alloc_large(size_t granules) {
+  struct chunk *chunk =
+      new_chunk((granules * GRANULE + PAGE - 1) & ~(size_t) (PAGE - 1), 1);
+  set_bit(chunk->starts, 0);
+  return chunk->base;
+}
+
+void *gc_alloc(size_t size, int has_pointers) {
+  const size_t granules = (size + GRANULE - 1) / GRANULE + 1;
+  if (granules > UINT32_MAX)
+    out_of_memory();
+
+  allocated_since_collection += granules * GRANULE;
+  if (allocated_since_collection > threshold)
+    gc_collect();
+
+  struct header *object;
+  if (granules * GRANULE > LARGE_OBJECT) {
+    object = alloc_large(granules);
+  } else {
+    if ((size_t) (limit - bump) < granules * GRANULE && !refill(granules)) {
+      bump_chunk = new_chunk(CHUNK_SIZE, 0);
+      bump = bump_chunk->base;
+      limit = bump + CHUNK_SIZE;
+    }
+    object = (struct header *) bump;
+    bump += granules * GRANULE;
+    set_bit(bump_chunk->starts, ((char *) object - bump_chunk->base) / GRANULE);
+  }
+
+  object->granules = granules;
+  object->has_pointers = has_pointers;
+  if (has_pointers)
+    memset(object + 1, 0, size);
+  return object + 1;
+}
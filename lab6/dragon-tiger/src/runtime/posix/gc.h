@@ -0,0 +1,51 @@
+#ifndef GC_H
+#define GC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A conservative, non-moving mark-and-sweep garbage collector for the
+// objects allocated by the runtime.
+//
+// The roots are the machine stack and the registers: any word which
+// looks like a pointer into an allocated object, including a pointer
+// to its interior, keeps the object alive. Objects allocated with
+// has_pointers set are themselves scanned for pointers when they are
+// reachable, other objects are never scanned.
+//
+// Objects are allocated by bumping a pointer through the free spans
+// found by the last collection. A collection happens when the memory
+// allocated since the previous one exceeds the size of the live data,
+// so that the heap stays within twice the live data (with a minimum
+// of a few megabytes).
+//
+// The collector is not thread-safe, and only scans the stack of the
+// thread which triggers the collection.
+
+// Allocate size bytes. If has_pointers is set, the memory is zeroed.
+// The result is aligned on 8 bytes.
+void *gc_alloc(size_t size, int has_pointers);
+
+// Run a full collection.
+void gc_collect(void);
+
+// The range of addresses the heap uses, empty before the first
+// allocation.
+extern char *gc_heap_start;
+extern size_t gc_heap_size;
+
+// Return 1 if p points into the heap, 0 otherwise. Every object
+// allocated by gc_alloc is in the heap, and no static or stack data.
+static inline int gc_contains(const void *p) {
+  return (uintptr_t) p - (uintptr_t) gc_heap_start < gc_heap_size;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GC_H
@@ -1,107 +1,418 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "gc.h"
 #include "runtime.h"
 
+// The standard output is buffered here rather than through stdio,
+// which locks the stream and parses a format on every call. The
+// buffer is flushed when full, on __flush, before reading input or
+// writing to standard error, and at exit. When the standard output is
+// a terminal, it is also flushed after every line.
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+static char output_buffer[OUTPUT_BUFFER_SIZE];
+static size_t output_size;
+static int output_is_terminal;
+
+static void write_all(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      // There is nobody left to report the error to.
+      return;
+    }
+    data += written;
+    size -= written;
+  }
+}
+
+static void flush_output(void) {
+  write_all(STDOUT_FILENO, output_buffer, output_size);
+  output_size = 0;
+}
+
+__attribute__((constructor))
+static void init_output(void) {
+  output_is_terminal = isatty(STDOUT_FILENO);
+  atexit(flush_output);
+}
+
+static void output(const char *data, size_t size) {
+  if (size > OUTPUT_BUFFER_SIZE - output_size) {
+    flush_output();
+    if (size >= OUTPUT_BUFFER_SIZE) {
+      write_all(STDOUT_FILENO, data, size);
+      return;
+    }
+  }
+  memcpy(output_buffer + output_size, data, size);
+  output_size += size;
+  if (output_is_terminal && memchr(data, '\n', size))
+    flush_output();
+}
+
 __attribute__((noreturn))
 static void error(const char *msg) {
+  flush_output();
   fprintf(stderr, "%s\n", msg);
   exit(EXIT_FAILURE);
 }
 
+// Statically allocated strings, with a header like the strings
+// allocated by the runtime: every single-character string, indexed by
+// its character, then the empty string. They are served from here,
+// without allocating.
+struct static_string {
+  struct __string_header header;
+  char chars[2];
+};
+
+#define EMPTY_STRING 256
+
+static struct static_string static_strings[257];
+
+__attribute__((constructor))
+static void init_static_strings(void) {
+  for (int i = 0; i < 256; i++) {
+    static_strings[i].header.kind = __STRING_FLAT;
+    static_strings[i].header.length = 1;
+    static_strings[i].chars[0] = (char) i;
+  }
+  static_strings[EMPTY_STRING].header.kind = __STRING_FLAT;
+  static_strings[EMPTY_STRING].header.length = 0;
+}
+
+// A rope is the lazy concatenation of two strings. It is flattened
+// the first time its characters are needed, and the flat string is
+// kept to serve later accesses.
+struct rope {
+  struct __string_header header;
+  const char *left;
+  const char *right;
+  const char *flat;
+};
+
+// Concatenations shorter than this are copied, longer ones build a
+// rope. A short right leaf of a rope is extended in place of creating
+// a new node, so that appending short strings in a loop does not
+// build one node per string.
+#define ROPE_MIN_LENGTH 256
+#define ROPE_LEAF_LENGTH 128
+
+#define ROPE(s) ((struct rope *) __STRING_HEADER(s))
+
+// Return 1 if s was built by the runtime and has a header, 0 if it
+// is a bare string literal emitted by the compiler. Both the heap and
+// the static strings are a single range of addresses.
+static inline int has_header(const char *s) {
+  return gc_contains(s) ||
+         (uintptr_t) s - (uintptr_t) static_strings < sizeof static_strings;
+}
+
+static inline int32_t string_length(const char *s) {
+  if (!has_header(s))
+    return strlen(s);
+  return __STRING_HEADER(s)->length;
+}
+
+static inline const char *single_char(unsigned char c) {
+  return static_strings[c].chars;
+}
+
+// Allocate a flat string of the given length. Its characters must
+// be filled by the caller, the final null byte is already there.
+static char *alloc_string(int32_t length) {
+  struct __string_header *header =
+      gc_alloc(sizeof(struct __string_header) + length + 1, 0);
+  header->kind = __STRING_FLAT;
+  header->length = length;
+  char *chars = (char *) (header + 1);
+  chars[length] = 0;
+  return chars;
+}
+
+static inline int is_rope(const char *s) {
+  return has_header(s) && __STRING_HEADER(s)->kind == __STRING_ROPE;
+}
+
+// Copy the characters of s, which may be a rope, to the given buffer.
+// The rope is walked from its end with an explicit stack of left
+// parts, so that the long left-leaning ropes built by appending in a
+// loop only need a single stack slot.
+static void copy_string(char *buffer, const char *s) {
+  const char **stack = NULL;
+  size_t size = 0, capacity = 0;
+  char *end = buffer + string_length(s);
+  for (;;) {
+    while (is_rope(s) && !ROPE(s)->flat) {
+      if (size == capacity) {
+        capacity = capacity ? 2 * capacity : 16;
+        stack = realloc(stack, capacity * sizeof(const char *));
+        if (!stack)
+          error("out of memory");
+      }
+      stack[size++] = ROPE(s)->left;
+      s = ROPE(s)->right;
+    }
+    const char *chars = is_rope(s) ? ROPE(s)->flat : s;
+    end -= string_length(s);
+    memcpy(end, chars, string_length(s));
+    if (size == 0)
+      break;
+    s = stack[--size];
+  }
+  free(stack);
+}
+
+// Return the characters of s, flattening it if it is a rope.
+static const char *flat(const char *s) {
+  if (!is_rope(s))
+    return s;
+  struct rope *rope = ROPE(s);
+  if (!rope->flat) {
+    char *string = alloc_string(rope->header.length);
+    copy_string(string, s);
+    rope->flat = string;
+    // The parts are no longer needed and can be collected.
+    rope->left = rope->right = NULL;
+  }
+  return rope->flat;
+}
+
+static const char *make_rope(const char *left, const char *right) {
+  struct rope *rope = gc_alloc(sizeof(struct rope), 1);
+  rope->header.kind = __STRING_ROPE;
+  rope->header.length = string_length(left) + string_length(right);
+  rope->left = left;
+  rope->right = right;
+  return (const char *) (&rope->header + 1);
+}
+
+// Return a flat string holding a copy of the given characters.
+static const char *make_string(const char *chars, size_t length) {
+  if (length == 0)
+    return static_strings[EMPTY_STRING].chars;
+  if (length == 1)
+    return single_char(*chars);
+  if (length > INT32_MAX)
+    error("string too long");
+  char *string = alloc_string(length);
+  memcpy(string, chars, length);
+  return string;
+}
+
+// The standard input is read by blocks, or mapped in memory at once
+// when it is a regular file. input_data holds the characters which
+// have not been read yet, from input_position to input_size.
+#define INPUT_BLOCK_SIZE (64 * 1024)
+
+static const char *input_data;
+static size_t input_size;
+static size_t input_position;
+static int input_mapped;
+static int input_eof;
+
+static int map_input(void) {
+  struct stat st;
+  if (fstat(STDIN_FILENO, &st) < 0 || !S_ISREG(st.st_mode))
+    return 0;
+  off_t offset = lseek(STDIN_FILENO, 0, SEEK_CUR);
+  if (offset < 0 || offset >= st.st_size)
+    return 0;
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+  if (data == MAP_FAILED)
+    return 0;
+  input_data = data;
+  input_size = st.st_size;
+  input_position = offset;
+  input_mapped = 1;
+  return 1;
+}
+
+// Make sure that some input is available, and return 0 at end of file.
+static int fill_input(void) {
+  static char *block;
+  if (input_position < input_size)
+    return 1;
+  if (input_eof || input_mapped)
+    return 0;
+  if (!block && map_input())
+    return 1;
+  if (!block && !(block = malloc(INPUT_BLOCK_SIZE)))
+    error("out of memory");
+  ssize_t size;
+  do
+    size = read(STDIN_FILENO, block, INPUT_BLOCK_SIZE);
+  while (size < 0 && errno == EINTR);
+  if (size <= 0) {
+    input_eof = 1;
+    return 0;
+  }
+  input_data = block;
+  input_size = size;
+  input_position = 0;
+  return 1;
+}
+
+// Read characters up to and including the next newline if line is
+// set, or up to the end of the input otherwise.
+static const char *read_input(int line) {
+  char *buffer = NULL;
+  size_t size = 0, capacity = 0;
+  while (fill_input()) {
+    const char *start = input_data + input_position;
+    const size_t available = input_size - input_position;
+    const char *newline = line ? memchr(start, '\n', available) : NULL;
+    const size_t length = newline ? (size_t) (newline - start + 1) : available;
+    input_position += length;
+    // Most of the time, the whole result is available at once.
+    if (size == 0 && (newline || input_mapped))
+      return make_string(start, length);
+    if (size + length > capacity) {
+      capacity = 2 * (size + length);
+      if (!(buffer = realloc(buffer, capacity)))
+        error("out of memory");
+    }
+    memcpy(buffer + size, start, length);
+    size += length;
+    if (newline)
+      break;
+  }
+  const char *result = make_string(buffer, size);
+  free(buffer);
+  return result;
+}
+
 void __print_err(const char *s) {
-  fprintf(stderr, "%s", s);
+  flush_output();
+  write_all(STDERR_FILENO, flat(s), string_length(s));
 }
 
 void __print(const char *s) {
-  printf("%s", s);
+  output(flat(s), string_length(s));
 }
 
 void __print_int(const int32_t i) {
-  printf("%i", i);
+  char buffer[11];
+  char *p = buffer + sizeof buffer;
+  uint32_t n = i < 0 ? -(uint32_t) i : (uint32_t) i;
+  do {
+    *--p = '0' + n % 10;
+    n /= 10;
+  } while (n);
+  if (i < 0)
+    *--p = '-';
+  output(p, buffer + sizeof buffer - p);
 }
 
 void __flush(void) {
-  fflush(stdout);
+  flush_output();
 }
 
 const char *__getchar(void) {
-  char c = getchar();
-  char * character = malloc(sizeof(c));
-  *character = c;
-  if( c == EOF)
-	  return("");
-  else
-  	return(character);
+  // Make prompts visible before waiting for input.
+  flush_output();
+  if (!fill_input())
+    return static_strings[EMPTY_STRING].chars;
+  return single_char(input_data[input_position++]);
+}
+
+const char *__getline(void) {
+  flush_output();
+  return read_input(1);
+}
+
+const char *__readall(void) {
+  flush_output();
+  return read_input(0);
 }
 
 int32_t __ord(const char *s) {
-  if(*s == 0)
-	  return(-1);
-  int32_t ho = (unsigned char) *s;
-  return(ho);
+  if (string_length(s) == 0)
+    return -1;
+  return (unsigned char) *flat(s);
 }
 
 const char *__chr(int32_t i) {
-  char * c = malloc(sizeof(char));
-  if(i < 0 || i > 255)
-	  error("ASCII character must be between 0 and 255"); 
-  *c = (char) i;
-  return(c);
+  if (i < 0 || i > 255)
+    error("ASCII character must be between 0 and 255");
+  if (i == 0)
+    return static_strings[EMPTY_STRING].chars;
+  return single_char(i);
 }
 
 int32_t __size(const char *s) {
-  return(strlen(s));
+  return string_length(s);
 }
 
 const char *__substring(const char *s, int32_t first, int32_t length) {
-  int size = __size(s);
-  if( length < 0 || first < 0 || first + length > size)
-	  error("Impossible to get a substring: index out of bounds or negative parameter");
-  if(length == 0 && first == 0)
-	  return("");
-  else if(length == 0 && first != 0)
-	  error("Wrong usage of __substring function");
-
-  char * string = malloc(length*sizeof(char));
-  for(int i = 0; i < length; i++){
-	  string[i] = s[i+first];
-  }
-  return(string);
-
+  const int32_t size = __size(s);
+  if (length < 0 || first < 0 || first > size - length)
+    error("Impossible to get a substring: index out of bounds or negative parameter");
+  if (length == size)
+    return s;
+  return make_string(flat(s) + first, length);
 }
 
 const char *__concat(const char *s1, const char *s2) {
-  char * tmp ;
-  tmp = malloc(sizeof(s1)+sizeof(s2));
-  strcpy(tmp, s1);
-  return(strcat(tmp, s2));
+  const int32_t length1 = string_length(s1);
+  const int32_t length2 = string_length(s2);
+  if (length1 == 0)
+    return s2;
+  if (length2 == 0)
+    return s1;
+  if (length1 > INT32_MAX - length2)
+    error("string too long");
+  if (length1 + length2 < ROPE_MIN_LENGTH) {
+    char *string = alloc_string(length1 + length2);
+    memcpy(string, s1, length1);
+    memcpy(string + length1, s2, length2);
+    return string;
+  }
+  if (is_rope(s1) && !ROPE(s1)->flat && !is_rope(ROPE(s1)->right) &&
+      string_length(ROPE(s1)->right) + length2 < ROPE_LEAF_LENGTH)
+    return make_rope(ROPE(s1)->left, __concat(ROPE(s1)->right, s2));
+  return make_rope(s1, s2);
 }
 
 int32_t __strcmp(const char *s1, const char *s2) {
-  int32_t result = strcmp(s1, s2);
-  if( result > 0)
-	  return(1);
-  else if(result < 0)
-	  return(-1);
+  const int32_t length1 = string_length(s1);
+  const int32_t length2 = string_length(s2);
+  s1 = flat(s1);
+  s2 = flat(s2);
+  int result = memcmp(s1, s2, length1 < length2 ? length1 : length2);
+  if (result == 0)
+    result = length1 - length2;
+  if (result > 0)
+    return 1;
+  else if (result < 0)
+    return -1;
   else
-	  return(0);
+    return 0;
 }
 
 int32_t __streq(const char *s1, const char *s2) {
-  int32_t result = __strcmp(s1, s2);
-  if(result == 0)
-	  return(1);
-  else
-	  return(0);
-
+  const int32_t length1 = string_length(s1);
+  if (s1 == s2)
+    return 1;
+  if (length1 != string_length(s2))
+    return 0;
+  return memcmp(flat(s1), flat(s2), length1) == 0;
 }
 
 int32_t __not(int32_t i) {
-  return(!i);
+  return !i;
 }
 
 void __exit(int32_t c) {
+  flush_output();
   exit(c);
 }
@@ -3,16 +3,42 @@
 
 #include <stdint.h>
 
-// Print a null-terminated string on standard error.
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Tiger strings are immutable. A string is a pointer to its
+// null-terminated characters. The strings built by the runtime are
+// also preceded by a header holding the kind of the string and its
+// length, so that their length is known without scanning them. String
+// literals emitted by the compiler are bare characters, without a
+// header: the runtime tells them apart by their address, and only
+// reads the header of the strings it allocated itself.
+struct __string_header {
+  int32_t kind;
+  int32_t length;
+};
+
+// Kinds of strings. Characters of a flat string directly follow
+// its header. A rope, built by concatenating long strings, holds
+// pointers to its parts instead and is only flattened by the runtime
+// when its characters are needed.
+enum { __STRING_FLAT = 0, __STRING_ROPE = 1 };
+
+// Return the header of the string s, which must have been built by
+// the runtime.
+#define __STRING_HEADER(s) ((struct __string_header *)(s)-1)
+
+// Print a string on standard error.
 void __print_err(const char *s);
 
-// Print a null-terminated string on standard output.
+// Print a string on standard output.
 void __print(const char *s);
 
 // Print a 32 bit signed integer on standard output.
 void __print_int(int32_t i);
 
-// Flush the standard output.
+// Flush the standard output, which is buffered by the runtime.
 void __flush(void);
 
 // Read a char from standard input and return a string
@@ -20,6 +46,13 @@ void __flush(void);
 // return the empty string.
 const char *__getchar(void);
 
+// Read a line from standard input and return it, including its final
+// newline if any. At end-of-file, return the empty string.
+const char *__getline(void);
+
+// Read standard input until end-of-file and return its content.
+const char *__readall(void);
+
 // Return the ASCII code of the char in first position
 // in the string, or -1 if the string is empty.
 int32_t __ord(const char *s);
@@ -30,7 +63,7 @@ int32_t __ord(const char *s);
 // bail out with a fatal runtime error.
 const char *__chr(int32_t i);
 
-// Return the length of a string.
+// Return the length of a string in constant time.
 int32_t __size(const char *);
 
 // Return a substring of s starting at character first
@@ -58,4 +91,8 @@ int32_t __not(int32_t i);
 // Exit to the operating system with the given exit status.
 void __exit(int32_t c);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // RUNTIME_H
@@ -1,10 +1,21 @@
 #include <cstdlib>
 #include <iostream>
+#include <sstream>
 
 #include "errors.hh"
 
 namespace utils {
 
+namespace {
+
+thread_local bool throw_errors = false;
+
+} // namespace
+
+ThrowErrors::ThrowErrors() : saved(throw_errors) { throw_errors = true; }
+
+ThrowErrors::~ThrowErrors() { throw_errors = saved; }
+
 void non_fatal_error(const yy::location &l, const std::string &m) {
   std::cerr << l << ": " << m << std::endl;
 }
@@ -12,11 +23,18 @@ void non_fatal_error(const yy::location &l, const std::string &m) {
 void non_fatal_error(const std::string &m) { std::cerr << m << std::endl; }
 
 void error(const yy::location &l, const std::string &m) {
+  if (throw_errors) {
+    std::ostringstream message;
+    message << l << ": " << m;
+    throw Error(message.str());
+  }
   non_fatal_error(l, m);
   exit(EXIT_FAILURE);
 }
 
 void error(const std::string &m) {
+  if (throw_errors)
+    throw Error(m);
   non_fatal_error(m);
   exit(EXIT_FAILURE);
 }
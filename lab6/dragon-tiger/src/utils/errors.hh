@@ -1,6 +1,8 @@
 #ifndef ERRORS_HH
 #define ERRORS_HH
 
+#include <stdexcept>
+
 #include "../parser/tiger_parser.hh"
 
 namespace utils {
@@ -8,6 +10,24 @@ namespace utils {
 [[noreturn]] void error(const yy::location &l, const std::string &m);
 [[noreturn]] void error(const std::string &m);
 
+// An error reported while a ThrowErrors exists, holding the message
+// which would have been printed.
+class Error : public std::runtime_error {
+public:
+  explicit Error(const std::string &m) : std::runtime_error(m) {}
+};
+
+// While an instance exists, error() throws an Error on the current
+// thread instead of printing the message and exiting, so that worker
+// threads can hand their errors over to the main thread.
+class ThrowErrors {
+  const bool saved;
+
+public:
+  ThrowErrors();
+  ~ThrowErrors();
+};
+
 void non_fatal_error(const yy::location &l, const std::string &m);
 void non_fatal_error(const std::string &m);
 
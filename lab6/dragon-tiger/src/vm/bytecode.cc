@@ -0,0 +1,98 @@
+#include <cstring>
+#include <iomanip>
+
+#include "bytecode.hh"
+#include "../runtime/posix/runtime.h"
+
+namespace vm {
+
+namespace {
+
+#define VM_OPCODE_NAME(name, operands) #name,
+const char *const opcode_names[] = {VM_OPCODES(VM_OPCODE_NAME)};
+#undef VM_OPCODE_NAME
+
+#define VM_PRIMITIVE_NAME(name, tiger_name, signature) tiger_name,
+const char *const primitive_names[] = {VM_PRIMITIVES(VM_PRIMITIVE_NAME)};
+#undef VM_PRIMITIVE_NAME
+
+} // namespace
+
+#define VM_OPERAND_KINDS(name, operands) operands,
+const char *const operand_kinds[] = {VM_OPCODES(VM_OPERAND_KINDS)};
+#undef VM_OPERAND_KINDS
+
+#define VM_PRIMITIVE_SIGNATURE(name, tiger_name, signature) signature,
+const char *const primitive_signatures[] = {
+    VM_PRIMITIVES(VM_PRIMITIVE_SIGNATURE)};
+#undef VM_PRIMITIVE_SIGNATURE
+
+bool find_primitive(const std::string &external_name, Primitive &primitive) {
+  for (unsigned i = 0; i < sizeof(primitive_names) / sizeof(*primitive_names);
+       i++)
+    if (external_name == std::string("__") + primitive_names[i]) {
+      primitive = Primitive(i);
+      return true;
+    }
+  return false;
+}
+
+int32_t Program::add_string(const std::string &s) {
+  const size_t offset = string_data.size();
+  const size_t words = (sizeof(__string_header) + s.size() + 8) / 8;
+  string_data.resize(offset + words);
+  __string_header header = {__STRING_FLAT, int32_t(s.size())};
+  char *const base = reinterpret_cast<char *>(&string_data[offset]);
+  memcpy(base, &header, sizeof(header));
+  memcpy(base + sizeof(header), s.c_str(), s.size() + 1);
+  string_offsets.push_back(offset);
+  return string_offsets.size() - 1;
+}
+
+const char *Program::string(int32_t index) const {
+  return reinterpret_cast<const char *>(&string_data[string_offsets[index]]) +
+         sizeof(__string_header);
+}
+
+void Program::dump(std::ostream &out) const {
+  size_t f = 0;
+  for (size_t pc = 0; pc < code.size();) {
+    for (; f < functions.size() && size_t(functions[f].entry) <= pc; f++)
+      out << functions[f].name << " (" << functions[f].frame_size
+          << " registers):\n";
+    const Opcode op = Opcode(code[pc]);
+    out << std::setw(6) << pc << "  " << std::left << std::setw(8)
+        << opcode_names[op] << std::right;
+    const char *kinds = operand_kinds[op];
+    for (unsigned i = 0; kinds[i]; i++) {
+      const int32_t operand = code[pc + 1 + i];
+      out << (i ? ", " : " ");
+      switch (kinds[i]) {
+      case 'r':
+        out << 'r' << operand;
+        break;
+      case 't':
+        out << '@' << operand;
+        break;
+      case 's':
+        out << '"' << string(operand) << '"';
+        break;
+      case 'f':
+        out << functions[operand].name;
+        break;
+      case 'p':
+        out << primitive_names[operand];
+        break;
+      case 'h':
+        out << '^' << operand;
+        break;
+      default:
+        out << operand;
+      }
+    }
+    out << "\n";
+    pc += 1 + operand_count[op];
+  }
+}
+
+} // namespace vm
@@ -0,0 +1,144 @@
+#ifndef BYTECODE_HH
+#define BYTECODE_HH
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace vm {
+
+// The bytecode is a flat array of 32 bit words. Each instruction is an
+// opcode followed by a fixed number of operands, whose kinds are given
+// by a string in the table below:
+//   r  a register, relative to the current frame
+//   i  an immediate integer
+//   t  a jump target, as an absolute offset in the code
+//   s  the index of a string literal
+//   f  the index of a function
+//   p  a primitive (see VM_PRIMITIVES)
+//   h  a number of static links to follow
+//
+// Instructions which produce a value have their destination register
+// as first operand.
+//
+// Registers hold 64 bits, enough for both integers and strings. Register
+// 0 of a frame holds its static link, which is the index of the frame of
+// the enclosing function in the register file, and the parameters of
+// the function come next.
+#define VM_OPCODES(X)                                                          \
+  X(LOADI, "ri")    /* dst = imm */                                            \
+  X(LOADS, "rs")    /* dst = string literal */                                 \
+  X(MOVE, "rr")     /* dst = src */                                            \
+  X(GETUP, "rhr")   /* dst = register of an enclosing frame */                 \
+  X(SETUP, "hrr")   /* register of an enclosing frame = src */                 \
+  X(ADD, "rrr")     /* dst = a + b */                                          \
+  X(ADDI, "rri")    /* dst = a + imm */                                        \
+  X(SUB, "rrr")     /* dst = a - b */                                          \
+  X(MUL, "rrr")     /* dst = a * b */                                          \
+  X(DIV, "rrr")     /* dst = a / b */                                          \
+  X(EQ, "rrr")      /* dst = a == b */                                         \
+  X(NE, "rrr")      /* dst = a != b */                                         \
+  X(LT, "rrr")      /* dst = a < b */                                          \
+  X(LE, "rrr")      /* dst = a <= b */                                         \
+  X(GT, "rrr")      /* dst = a > b */                                          \
+  X(GE, "rrr")      /* dst = a >= b */                                         \
+  X(STREQ, "rrr")   /* dst = a == b, on strings */                             \
+  X(STRNE, "rrr")   /* dst = a != b, on strings */                             \
+  X(STRLT, "rrr")   /* dst = a < b, on strings */                              \
+  X(STRLE, "rrr")   /* dst = a <= b, on strings */                             \
+  X(STRGT, "rrr")   /* dst = a > b, on strings */                              \
+  X(STRGE, "rrr")   /* dst = a >= b, on strings */                             \
+  X(JMP, "t")       /* goto target */                                          \
+  X(JZ, "rt")       /* if a == 0 goto target */                                \
+  X(JNZ, "rt")      /* if a != 0 goto target */                                \
+  X(JEQ, "rrt")     /* if a == b goto target */                                \
+  X(JNE, "rrt")     /* if a != b goto target */                                \
+  X(JLT, "rrt")     /* if a < b goto target */                                 \
+  X(JLE, "rrt")     /* if a <= b goto target */                                \
+  X(JGT, "rrt")     /* if a > b goto target */                                 \
+  X(JGE, "rrt")     /* if a >= b goto target */                                \
+  X(FORLOOP, "rrt") /* if index < high, increment index and goto target */    \
+  X(LINK, "rh")     /* dst = index of an enclosing frame */                    \
+  X(CALL, "fr")     /* call function with its frame starting at register */    \
+  X(PRIM, "rprrr")  /* dst = primitive(a, b, c) */                             \
+  X(RET, "r")       /* return src into register 0 of the callee frame */       \
+  X(RETV, "")       /* return from a void function */
+
+// Runtime primitives which can be called with PRIM, with the names they
+// have in Tiger and their signatures: the result type followed by the
+// parameter types, each one being i (int), s (string) or v (void).
+#define VM_PRIMITIVES(X)                                                       \
+  X(print_err, "print_err", "vs")                                              \
+  X(print, "print", "vs")                                                      \
+  X(print_int, "print_int", "vi")                                              \
+  X(flush, "flush", "v")                                                       \
+  X(getchar, "getchar", "s")                                                   \
+  X(getline, "getline", "s")                                                   \
+  X(readall, "readall", "s")                                                   \
+  X(ord, "ord", "is")                                                          \
+  X(chr, "chr", "si")                                                          \
+  X(size, "size", "is")                                                        \
+  X(substring, "substring", "ssii")                                            \
+  X(concat, "concat", "sss")                                                   \
+  X(strcmp, "strcmp", "iss")                                                   \
+  X(streq, "streq", "iss")                                                     \
+  X(lnot, "not", "ii")                                                         \
+  X(exit, "exit", "vi")
+
+#define VM_ENUM_OPCODE(name, operands) op_##name,
+typedef enum { VM_OPCODES(VM_ENUM_OPCODE) } Opcode;
+#undef VM_ENUM_OPCODE
+
+#define VM_ENUM_PRIMITIVE(name, tiger_name, signature) p_##name,
+typedef enum { VM_PRIMITIVES(VM_ENUM_PRIMITIVE) } Primitive;
+#undef VM_ENUM_PRIMITIVE
+
+// Kinds of the operands of each opcode.
+extern const char *const operand_kinds[];
+
+// Number of operands of each opcode.
+#define VM_OPERAND_COUNT(name, operands) sizeof(operands) - 1,
+constexpr unsigned operand_count[] = {VM_OPCODES(VM_OPERAND_COUNT)};
+#undef VM_OPERAND_COUNT
+
+// Signature of each primitive.
+extern const char *const primitive_signatures[];
+
+// Find a primitive from the external name of its declaration. Return
+// false if there is none.
+bool find_primitive(const std::string &external_name, Primitive &primitive);
+
+struct Function {
+  std::string name;
+  // Offset of the first instruction in the code.
+  int32_t entry;
+  // Number of registers of a frame, including the static link.
+  int32_t frame_size;
+  // Number of parameters, held in the registers following the static
+  // link.
+  int32_t params;
+};
+
+struct Program {
+  std::vector<int32_t> code;
+  // The program entry point is the first function.
+  std::vector<Function> functions;
+  // String literals, laid out like runtime strings: a header holding
+  // the kind and length of the string, followed by its characters.
+  // Only the interpreter reads the header, the runtime handles these
+  // strings as compiler literals.
+  std::vector<uint64_t> string_data;
+  std::vector<size_t> string_offsets;
+
+  // Add a string literal and return its index.
+  int32_t add_string(const std::string &s);
+  const char *string(int32_t index) const;
+
+  // Print a readable listing of the program.
+  void dump(std::ostream &out) const;
+};
+
+} // namespace vm
+
+#endif // BYTECODE_HH
@@ -0,0 +1,387 @@
+#include <algorithm>
+
+#include "compiler.hh"
+#include "../utils/errors.hh"
+
+namespace vm {
+
+namespace {
+
+const Opcode int_opcodes[] = {op_ADD, op_SUB, op_MUL, op_DIV, op_EQ,
+                              op_NE,  op_LT,  op_LE,  op_GT,  op_GE};
+
+// Opcodes for the comparisons, indexed from o_eq.
+const Opcode string_opcodes[] = {op_STREQ, op_STRNE, op_STRLT,
+                                 op_STRLE, op_STRGT, op_STRGE};
+const Opcode jump_opcodes[] = {op_JEQ, op_JNE, op_JLT,
+                               op_JLE, op_JGT, op_JGE};
+const Opcode inverted_jump_opcodes[] = {op_JNE, op_JEQ, op_JGE,
+                                        op_JGT, op_JLE, op_JLT};
+
+const IntegerLiteral *as_int(const Expr &expr) {
+  return dynamic_cast<const IntegerLiteral *>(&expr);
+}
+
+// Whether evaluating the expression cannot assign any variable.
+bool is_simple(const Expr &expr) {
+  return as_int(expr) || dynamic_cast<const StringLiteral *>(&expr) ||
+         dynamic_cast<const Identifier *>(&expr);
+}
+
+} // namespace
+
+Program Compiler::compile_program(const FunDecl &main) {
+  function_id(main);
+  // Nested functions are queued when their declaration is met, after
+  // the registers of the variables they may access have been assigned.
+  for (size_t i = 0; i < pending.size(); i++)
+    compile_function(*pending[i]);
+  return std::move(program);
+}
+
+int32_t Compiler::function_id(const FunDecl &decl) {
+  auto known = functions.find(&decl);
+  if (known != functions.end())
+    return known->second;
+  const int32_t id = program.functions.size();
+  program.functions.push_back({decl.get_external_name().get(), -1, 0,
+                               int32_t(decl.get_params().size())});
+  functions[&decl] = id;
+  pending.push_back(&decl);
+  return id;
+}
+
+void Compiler::compile_function(const FunDecl &decl) {
+  const int32_t id = functions.at(&decl);
+  program.functions[id].entry = program.code.size();
+  last_destination = -1;
+  // Register 0 holds the static link.
+  is_variable.assign(1, false);
+  next_register = frame_size = 1;
+  for (auto param : decl.get_params())
+    new_variable(*param);
+
+  const Expr &body = *decl.get_expr();
+  const int32_t result = body.accept(*this);
+  if (body.get_type() == t_void)
+    emit(op_RETV, {});
+  else
+    emit(op_RET, {result});
+  program.functions[id].frame_size = frame_size;
+}
+
+int32_t Compiler::new_register() {
+  const int32_t reg = next_register++;
+  frame_size = std::max(frame_size, next_register);
+  if (is_variable.size() <= size_t(reg))
+    is_variable.resize(reg + 1);
+  is_variable[reg] = false;
+  return reg;
+}
+
+int32_t Compiler::new_variable(const VarDecl &decl) {
+  const int32_t reg = new_register();
+  is_variable[reg] = true;
+  slots[&decl] = reg;
+  return reg;
+}
+
+void Compiler::emit(Opcode op, std::initializer_list<int32_t> operands) {
+  assert(operands.size() == operand_count[op]);
+  program.code.push_back(op);
+  program.code.insert(program.code.end(), operands);
+  last_destination = -1;
+}
+
+int32_t Compiler::emit_value(Opcode op,
+                             std::initializer_list<int32_t> operands) {
+  const int32_t position = program.code.size() + 1;
+  emit(op, operands);
+  last_destination = position;
+  return program.code[position];
+}
+
+int32_t Compiler::label() {
+  last_destination = -1;
+  return program.code.size();
+}
+
+void Compiler::patch(int32_t position) {
+  program.code[position] = label();
+}
+
+// Copy a value into a register. When the value is a temporary computed
+// by the previous instruction, that instruction is retargeted instead.
+void Compiler::move_into(int32_t destination, int32_t source) {
+  if (destination == source)
+    return;
+  if (last_destination >= 0 && program.code[last_destination] == source &&
+      !is_variable[source])
+    program.code[last_destination] = destination;
+  else
+    emit_value(op_MOVE, {destination, source});
+}
+
+// Copy a variable into a temporary if the expressions evaluated before
+// it is used may assign it.
+int32_t Compiler::protect(int32_t reg, bool clobbered) {
+  if (!clobbered || reg < 0 || !is_variable[reg])
+    return reg;
+  return emit_value(op_MOVE, {new_register(), reg});
+}
+
+// Emit jumps taken when the condition is non-zero (if when is true) or
+// zero (if when is false), and add their target operands to jumps.
+void Compiler::branch(const Expr &condition, bool when,
+                      std::vector<int32_t> &jumps) {
+  const int32_t mark = next_register;
+  auto binop = dynamic_cast<const BinaryOperator *>(&condition);
+  if (binop && binop->op >= o_eq && binop->get_left().get_type() == t_int) {
+    const Expr &right = binop->get_right();
+    const int32_t left =
+        protect(binop->get_left().accept(*this), !is_simple(right));
+    const int32_t r = right.accept(*this);
+    emit(when ? jump_opcodes[binop->op - o_eq]
+              : inverted_jump_opcodes[binop->op - o_eq],
+         {left, r, -1});
+    jumps.push_back(program.code.size() - 1);
+  } else if (auto literal = as_int(condition)) {
+    if ((literal->value != 0) == when) {
+      emit(op_JMP, {-1});
+      jumps.push_back(program.code.size() - 1);
+    }
+  } else {
+    emit(when ? op_JNZ : op_JZ, {condition.accept(*this), -1});
+    jumps.push_back(program.code.size() - 1);
+  }
+  next_register = mark;
+}
+
+int32_t Compiler::static_hops(const Identifier &id) const {
+  return id.get_depth() - id.get_decl()->get_depth();
+}
+
+int32_t Compiler::visit(const IntegerLiteral &literal) {
+  return emit_value(op_LOADI, {new_register(), literal.value});
+}
+
+int32_t Compiler::visit(const StringLiteral &literal) {
+  auto known = strings.find(literal.value);
+  const int32_t index = known != strings.end()
+                            ? known->second
+                            : (strings[literal.value] =
+                                   program.add_string(literal.value.get()));
+  return emit_value(op_LOADS, {new_register(), index});
+}
+
+int32_t Compiler::visit(const BinaryOperator &op) {
+  const int32_t mark = next_register;
+  const Expr &right = op.get_right();
+  const int32_t left = protect(op.get_left().accept(*this), !is_simple(right));
+
+  if (op.get_left().get_type() == t_string) {
+    const int32_t r = right.accept(*this);
+    next_register = mark;
+    return emit_value(string_opcodes[op.op - o_eq],
+                      {new_register(), left, r});
+  }
+
+  auto literal = as_int(right);
+  if (literal && (op.op == o_plus || op.op == o_minus)) {
+    const int32_t value = op.op == o_plus
+                              ? literal->value
+                              : int32_t(-uint32_t(literal->value));
+    next_register = mark;
+    return emit_value(op_ADDI, {new_register(), left, value});
+  }
+
+  const int32_t r = right.accept(*this);
+  next_register = mark;
+  return emit_value(int_opcodes[op.op], {new_register(), left, r});
+}
+
+int32_t Compiler::visit(const Sequence &seq) {
+  const int32_t mark = next_register;
+  int32_t result = -1;
+  for (auto expr : seq.get_exprs()) {
+    next_register = mark;
+    result = expr->accept(*this);
+  }
+  return result;
+}
+
+int32_t Compiler::visit(const Let &let) {
+  for (auto decl : let.get_decls())
+    decl->accept(*this);
+  return let.get_sequence().accept(*this);
+}
+
+int32_t Compiler::visit(const Identifier &id) {
+  const int32_t slot = slots.at(&*id.get_decl());
+  const int32_t hops = static_hops(id);
+  if (hops == 0)
+    return slot;
+  return emit_value(op_GETUP, {new_register(), hops, slot});
+}
+
+int32_t Compiler::visit(const IfThenElse &ite) {
+  const int32_t mark = next_register;
+  std::vector<int32_t> else_jumps, end_jumps;
+  branch(ite.get_condition(), false, else_jumps);
+
+  const bool has_value = ite.get_type() != t_void;
+  const int32_t result = has_value ? new_register() : -1;
+  const int32_t after = next_register;
+  const int32_t then_value = ite.get_then_part().accept(*this);
+  if (has_value)
+    move_into(result, then_value);
+  next_register = after;
+
+  auto else_seq = dynamic_cast<const Sequence *>(&ite.get_else_part());
+  if (!else_seq || !else_seq->get_exprs().empty()) {
+    emit(op_JMP, {-1});
+    end_jumps.push_back(program.code.size() - 1);
+  }
+  for (auto jump : else_jumps)
+    patch(jump);
+  const int32_t else_value = ite.get_else_part().accept(*this);
+  if (has_value)
+    move_into(result, else_value);
+  for (auto jump : end_jumps)
+    patch(jump);
+
+  next_register = has_value ? after : mark;
+  return result;
+}
+
+int32_t Compiler::visit(const VarDecl &decl) {
+  const int32_t mark = next_register;
+  const int32_t value = decl.get_expr()->accept(*this);
+  // A fresh temporary holding the initial value becomes the variable.
+  if (value >= mark && !is_variable[value]) {
+    is_variable[value] = true;
+    slots[&decl] = value;
+  } else {
+    const int32_t slot = new_variable(decl);
+    move_into(slot, value);
+  }
+  return -1;
+}
+
+int32_t Compiler::visit(const FunDecl &decl) {
+  function_id(decl);
+  return -1;
+}
+
+int32_t Compiler::visit(const FunCall &call) {
+  const FunDecl &decl = *call.get_decl();
+  const std::vector<Expr *> &args = call.get_args();
+  const int32_t mark = next_register;
+
+  if (!decl.get_expr()) {
+    Primitive primitive;
+    if (!find_primitive(decl.get_external_name().get(), primitive))
+      utils::error(call.loc, "unknown primitive " + call.func_name.get());
+    int32_t operands[3] = {0, 0, 0};
+    for (size_t i = 0; i < args.size(); i++) {
+      const bool clobbered =
+          std::any_of(args.begin() + i + 1, args.end(),
+                      [](const Expr *arg) { return !is_simple(*arg); });
+      operands[i] = protect(args[i]->accept(*this), clobbered);
+    }
+    next_register = mark;
+    if (call.get_type() == t_void) {
+      emit(op_PRIM, {0, primitive, operands[0], operands[1], operands[2]});
+      return -1;
+    }
+    return emit_value(op_PRIM, {new_register(), primitive, operands[0],
+                                operands[1], operands[2]});
+  }
+
+  // The frame of the callee starts at base, with the static link
+  // followed by the arguments. The result is returned into base.
+  const int32_t base = new_register();
+  for (size_t i = 0; i < args.size(); i++)
+    new_register();
+  for (size_t i = 0; i < args.size(); i++) {
+    const int32_t value = args[i]->accept(*this);
+    move_into(base + 1 + i, value);
+    next_register = base + 1 + args.size();
+  }
+  emit(op_LINK, {base, call.get_depth() - decl.get_depth()});
+  emit(op_CALL, {function_id(decl), base});
+
+  if (call.get_type() == t_void) {
+    next_register = mark;
+    return -1;
+  }
+  next_register = base + 1;
+  return base;
+}
+
+int32_t Compiler::visit(const WhileLoop &loop) {
+  const int32_t mark = next_register;
+  emit(op_JMP, {-1});
+  const int32_t to_condition = program.code.size() - 1;
+  const int32_t body = label();
+  loop_exits.emplace_back();
+  loop.get_body().accept(*this);
+  next_register = mark;
+
+  patch(to_condition);
+  std::vector<int32_t> back_jumps;
+  branch(loop.get_condition(), true, back_jumps);
+  for (auto jump : back_jumps)
+    program.code[jump] = body;
+  for (auto jump : loop_exits.back())
+    patch(jump);
+  loop_exits.pop_back();
+  return -1;
+}
+
+int32_t Compiler::visit(const ForLoop &loop) {
+  const int32_t mark = next_register;
+  const VarDecl &variable = loop.get_variable();
+  const int32_t index = new_variable(variable);
+  const int32_t low = variable.get_expr()->accept(*this);
+  move_into(index, low);
+  // The high bound is evaluated once, and must not change.
+  const int32_t high = protect(loop.get_high().accept(*this), true);
+  const int32_t body_mark = next_register;
+
+  loop_exits.emplace_back();
+  emit(op_JGT, {index, high, -1});
+  loop_exits.back().push_back(program.code.size() - 1);
+  const int32_t body = label();
+  loop.get_body().accept(*this);
+  next_register = body_mark;
+  emit(op_FORLOOP, {index, high, body});
+
+  for (auto jump : loop_exits.back())
+    patch(jump);
+  loop_exits.pop_back();
+  next_register = mark;
+  return -1;
+}
+
+int32_t Compiler::visit(const Break &) {
+  emit(op_JMP, {-1});
+  loop_exits.back().push_back(program.code.size() - 1);
+  return -1;
+}
+
+int32_t Compiler::visit(const Assign &assign) {
+  const int32_t mark = next_register;
+  const Identifier &lhs = assign.get_lhs();
+  const int32_t slot = slots.at(&*lhs.get_decl());
+  const int32_t value = assign.get_rhs().accept(*this);
+  const int32_t hops = static_hops(lhs);
+  if (hops == 0)
+    move_into(slot, value);
+  else
+    emit(op_SETUP, {hops, slot, value});
+  next_register = mark;
+  return -1;
+}
+
+} // namespace vm
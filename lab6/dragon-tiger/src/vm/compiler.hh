@@ -0,0 +1,72 @@
+#ifndef COMPILER_HH
+#define COMPILER_HH
+
+#include <initializer_list>
+#include <unordered_map>
+#include <vector>
+
+#include "../ast/nodes.hh"
+#include "bytecode.hh"
+
+namespace vm {
+
+using namespace ast;
+
+// Compiler translates a bound and type-checked program into bytecode.
+//
+// Visiting an expression emits its code and returns the register
+// holding its value, or -1 when it has none. Registers are allocated
+// as a stack: the temporaries of an expression are released once its
+// value has been consumed, and variables live in the registers
+// allocated when they are declared. Nested functions reach the
+// variables of their parents through static links.
+class Compiler : public ConstASTIntVisitor {
+  Program program;
+  std::unordered_map<const FunDecl *, int32_t> functions;
+  std::vector<const FunDecl *> pending;
+  std::unordered_map<Symbol, int32_t> strings;
+  std::unordered_map<const VarDecl *, int32_t> slots;
+
+  // State of the function being compiled.
+  int32_t next_register;
+  int32_t frame_size;
+  std::vector<bool> is_variable;
+  std::vector<std::vector<int32_t>> loop_exits;
+  // Position of the destination operand of the last instruction, or -1
+  // if it has none or the instruction is the target of a jump.
+  int32_t last_destination;
+
+  int32_t function_id(const FunDecl &);
+  void compile_function(const FunDecl &);
+  int32_t new_register();
+  int32_t new_variable(const VarDecl &);
+  void emit(Opcode, std::initializer_list<int32_t> operands);
+  int32_t emit_value(Opcode, std::initializer_list<int32_t> operands);
+  int32_t label();
+  void patch(int32_t position);
+  void move_into(int32_t destination, int32_t source);
+  int32_t protect(int32_t reg, bool clobbered);
+  void branch(const Expr &condition, bool when, std::vector<int32_t> &jumps);
+  int32_t static_hops(const Identifier &) const;
+
+public:
+  Program compile_program(const FunDecl &main);
+  virtual int32_t visit(const IntegerLiteral &);
+  virtual int32_t visit(const StringLiteral &);
+  virtual int32_t visit(const BinaryOperator &);
+  virtual int32_t visit(const Sequence &);
+  virtual int32_t visit(const Let &);
+  virtual int32_t visit(const Identifier &);
+  virtual int32_t visit(const IfThenElse &);
+  virtual int32_t visit(const VarDecl &);
+  virtual int32_t visit(const FunDecl &);
+  virtual int32_t visit(const FunCall &);
+  virtual int32_t visit(const WhileLoop &);
+  virtual int32_t visit(const ForLoop &);
+  virtual int32_t visit(const Break &);
+  virtual int32_t visit(const Assign &);
+};
+
+} // namespace vm
+
+#endif // COMPILER_HH
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include "interpreter.hh"
+#include "native.hh"
+#include "../runtime/posix/gc.h"
+#include "../runtime/posix/runtime.h"
+#include "../utils/errors.hh"
+
+namespace vm {
+
+namespace {
+
+// Initial number of registers of the register file.
+const size_t initial_registers = 64 * 1024;
+
+struct Return {
+  const int32_t *pc;
+  int64_t fp;
+};
+
+// The register file is allocated by the garbage collector and scanned
+// for pointers, so that strings only referenced from registers stay
+// alive. It is reachable as long as the interpreter runs, since the
+// interpreter keeps pointers to it on the machine stack.
+int64_t *allocate_registers(size_t count) {
+  return static_cast<int64_t *>(gc_alloc(count * sizeof(int64_t), 1));
+}
+
+int32_t string_equal(const char *a, const char *b) {
+  return a == b || (__STRING_HEADER(a)->length == __STRING_HEADER(b)->length &&
+                    __streq(a, b));
+}
+
+} // namespace
+
+int32_t run(const Program &program, unsigned jit_threshold) {
+  std::vector<const char *> strings(program.string_offsets.size());
+  for (size_t i = 0; i < strings.size(); i++)
+    strings[i] = program.string(i);
+  const int32_t *const code = program.code.data();
+  const Function *const functions = program.functions.data();
+
+  size_t capacity =
+      std::max<size_t>(initial_registers, functions[0].frame_size);
+  int64_t *regs = allocate_registers(capacity);
+  int64_t fp = 0;
+  int64_t *R = regs;
+  std::vector<Return> returns;
+  const int32_t *pc = code + functions[0].entry;
+  int32_t status = 0;
+
+  std::unique_ptr<NativeTier> tier;
+  std::vector<unsigned> calls;
+  if (jit_threshold) {
+    tier.reset(new NativeTier(program));
+    calls.assign(program.functions.size(), 0);
+  }
+
+#define VM_LABEL(name, operands) &&do_##name,
+  static const void *const dispatch[] = {VM_OPCODES(VM_LABEL)};
+#undef VM_LABEL
+
+// Operands of the current instruction.
+#define REG(n) R[pc[n]]
+#define INT(n) static_cast<int32_t>(REG(n))
+#define STR(n) reinterpret_cast<const char *>(REG(n))
+#define DISPATCH() goto *dispatch[*pc]
+#define NEXT(name)                                                             \
+  do {                                                                         \
+    pc += 1 + operand_count[op_##name];                                        \
+    DISPATCH();                                                                \
+  } while (0)
+#define JUMP_IF(cond)                                                          \
+  do {                                                                         \
+    if (cond) {                                                                \
+      pc = code + pc[3];                                                       \
+      DISPATCH();                                                              \
+    }                                                                          \
+    pc += 4;                                                                   \
+    DISPATCH();                                                                \
+  } while (0)
+
+  DISPATCH();
+
+do_LOADI:
+  REG(1) = pc[2];
+  NEXT(LOADI);
+do_LOADS:
+  REG(1) = reinterpret_cast<int64_t>(strings[pc[2]]);
+  NEXT(LOADS);
+do_MOVE:
+  REG(1) = REG(2);
+  NEXT(MOVE);
+do_GETUP: {
+  int64_t frame = fp;
+  for (int32_t hops = pc[2]; hops > 0; hops--)
+    frame = regs[frame];
+  REG(1) = regs[frame + pc[3]];
+  NEXT(GETUP);
+}
+do_SETUP: {
+  int64_t frame = fp;
+  for (int32_t hops = pc[1]; hops > 0; hops--)
+    frame = regs[frame];
+  regs[frame + pc[2]] = REG(3);
+  NEXT(SETUP);
+}
+// Arithmetic wraps around, as in compiled programs.
+do_ADD:
+  REG(1) = int32_t(uint32_t(INT(2)) + uint32_t(INT(3)));
+  NEXT(ADD);
+do_ADDI:
+  REG(1) = int32_t(uint32_t(INT(2)) + uint32_t(pc[3]));
+  NEXT(ADDI);
+do_SUB:
+  REG(1) = int32_t(uint32_t(INT(2)) - uint32_t(INT(3)));
+  NEXT(SUB);
+do_MUL:
+  REG(1) = int32_t(uint32_t(INT(2)) * uint32_t(INT(3)));
+  NEXT(MUL);
+do_DIV: {
+  const int32_t a = INT(2), b = INT(3);
+  if (b == 0)
+    utils::error("division by zero");
+  REG(1) = b == -1 ? int32_t(-uint32_t(a)) : a / b;
+  NEXT(DIV);
+}
+do_EQ:
+  REG(1) = INT(2) == INT(3);
+  NEXT(EQ);
+do_NE:
+  REG(1) = INT(2) != INT(3);
+  NEXT(NE);
+do_LT:
+  REG(1) = INT(2) < INT(3);
+  NEXT(LT);
+do_LE:
+  REG(1) = INT(2) <= INT(3);
+  NEXT(LE);
+do_GT:
+  REG(1) = INT(2) > INT(3);
+  NEXT(GT);
+do_GE:
+  REG(1) = INT(2) >= INT(3);
+  NEXT(GE);
+do_STREQ:
+  REG(1) = string_equal(STR(2), STR(3));
+  NEXT(STREQ);
+do_STRNE:
+  REG(1) = !string_equal(STR(2), STR(3));
+  NEXT(STRNE);
+do_STRLT:
+  REG(1) = __strcmp(STR(2), STR(3)) < 0;
+  NEXT(STRLT);
+do_STRLE:
+  REG(1) = __strcmp(STR(2), STR(3)) <= 0;
+  NEXT(STRLE);
+do_STRGT:
+  REG(1) = __strcmp(STR(2), STR(3)) > 0;
+  NEXT(STRGT);
+do_STRGE:
+  REG(1) = __strcmp(STR(2), STR(3)) >= 0;
+  NEXT(STRGE);
+do_JMP:
+  pc = code + pc[1];
+  DISPATCH();
+do_JZ:
+  if (!INT(1)) {
+    pc = code + pc[2];
+    DISPATCH();
+  }
+  NEXT(JZ);
+do_JNZ:
+  if (INT(1)) {
+    pc = code + pc[2];
+    DISPATCH();
+  }
+  NEXT(JNZ);
+do_JEQ:
+  JUMP_IF(INT(1) == INT(2));
+do_JNE:
+  JUMP_IF(INT(1) != INT(2));
+do_JLT:
+  JUMP_IF(INT(1) < INT(2));
+do_JLE:
+  JUMP_IF(INT(1) <= INT(2));
+do_JGT:
+  JUMP_IF(INT(1) > INT(2));
+do_JGE:
+  JUMP_IF(INT(1) >= INT(2));
+do_FORLOOP:
+  if (INT(1) < INT(2)) {
+    REG(1) = INT(1) + 1;
+    pc = code + pc[3];
+    DISPATCH();
+  }
+  NEXT(FORLOOP);
+do_LINK: {
+  int64_t frame = fp;
+  for (int32_t hops = pc[2]; hops > 0; hops--)
+    frame = regs[frame];
+  REG(1) = frame;
+  NEXT(LINK);
+}
+do_CALL: {
+  if (tier) {
+    // Native code runs on the machine stack and gets its arguments
+    // from the registers following the result one.
+    if (NativeFunction native = tier->native(pc[1])) {
+      REG(2) = native(&REG(2) + 1);
+      NEXT(CALL);
+    }
+    if (++calls[pc[1]] == jit_threshold)
+      tier->request(pc[1]);
+  }
+  const Function &callee = functions[pc[1]];
+  const int64_t callee_fp = fp + pc[2];
+  const size_t needed = callee_fp + callee.frame_size;
+  if (needed > capacity) {
+    size_t grown = 2 * capacity;
+    while (grown < needed)
+      grown *= 2;
+    int64_t *const registers = allocate_registers(grown);
+    memcpy(registers, regs, capacity * sizeof(int64_t));
+    regs = registers;
+    capacity = grown;
+  }
+  returns.push_back({pc + 1 + operand_count[op_CALL], fp});
+  fp = callee_fp;
+  R = regs + fp;
+  pc = code + callee.entry;
+  DISPATCH();
+}
+do_PRIM:
+  switch (Primitive(pc[2])) {
+  case p_print_err:
+    __print_err(STR(3));
+    break;
+  case p_print:
+    __print(STR(3));
+    break;
+  case p_print_int:
+    __print_int(INT(3));
+    break;
+  case p_flush:
+    __flush();
+    break;
+  case p_getchar:
+    REG(1) = reinterpret_cast<int64_t>(__getchar());
+    break;
+  case p_getline:
+    REG(1) = reinterpret_cast<int64_t>(__getline());
+    break;
+  case p_readall:
+    REG(1) = reinterpret_cast<int64_t>(__readall());
+    break;
+  case p_ord:
+    REG(1) = __ord(STR(3));
+    break;
+  case p_chr:
+    REG(1) = reinterpret_cast<int64_t>(__chr(INT(3)));
+    break;
+  case p_size:
+    REG(1) = __size(STR(3));
+    break;
+  case p_substring:
+    REG(1) =
+        reinterpret_cast<int64_t>(__substring(STR(3), INT(4), INT(5)));
+    break;
+  case p_concat:
+    REG(1) = reinterpret_cast<int64_t>(__concat(STR(3), STR(4)));
+    break;
+  case p_strcmp:
+    REG(1) = __strcmp(STR(3), STR(4));
+    break;
+  case p_streq:
+    REG(1) = __streq(STR(3), STR(4));
+    break;
+  case p_lnot:
+    REG(1) = !INT(3);
+    break;
+  case p_exit:
+    __exit(INT(3));
+  }
+  NEXT(PRIM);
+do_RET:
+  if (returns.empty()) {
+    status = INT(1);
+    goto done;
+  }
+  // The callee frame starts with the register receiving the result.
+  R[0] = REG(1);
+  /* fall through */
+do_RETV: {
+  if (returns.empty())
+    goto done;
+  const Return &r = returns.back();
+  pc = r.pc;
+  fp = r.fp;
+  R = regs + fp;
+  returns.pop_back();
+  DISPATCH();
+}
+
+#undef REG
+#undef INT
+#undef STR
+#undef DISPATCH
+#undef NEXT
+#undef JUMP_IF
+
+done:
+  // The runtime buffers the program output.
+  __flush();
+  return status;
+}
+
+} // namespace vm
@@ -0,0 +1,18 @@
+#ifndef INTERPRETER_HH
+#define INTERPRETER_HH
+
+#include "bytecode.hh"
+
+namespace vm {
+
+// Run a program and return its exit status. The primitives are those
+// of the runtime linked into dtiger.
+//
+// When jit_threshold is not 0, functions called that many times are
+// compiled to native code in the background (see NativeTier), and the
+// following calls run the native code.
+int32_t run(const Program &program, unsigned jit_threshold = 0);
+
+} // namespace vm
+
+#endif // INTERPRETER_HH
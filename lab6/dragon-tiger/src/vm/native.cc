@@ -0,0 +1,482 @@
+#include <map>
+
+#include "native.hh"
+#include "../backend/jit.hh"
+#include "../backend/optimizer.hh"
+#include "../utils/errors.hh"
+
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/Host.h"
+
+using namespace llvm;
+
+namespace vm {
+
+struct NativeTier::Module {
+  // The context must outlive the engine owning the module.
+  std::unique_ptr<LLVMContext> context;
+  std::unique_ptr<ExecutionEngine> engine;
+};
+
+namespace {
+
+[[noreturn]] void division_by_zero() { utils::error("division by zero"); }
+
+// Offset following the last instruction of a function.
+int32_t function_end(const Program &program, int32_t id) {
+  return size_t(id) + 1 < program.functions.size()
+             ? program.functions[id + 1].entry
+             : int32_t(program.code.size());
+}
+
+// Return the name under which the native entry point of a function is
+// exported from its module.
+std::string entry_name(const Function &function) {
+  return function.name + ".native";
+}
+
+// Translate the bytecode of a closed function into the body of an LLVM
+// function. Every register gets a stack slot, which the optimizer
+// promotes to SSA values.
+class Translator {
+  const Program &program;
+  const std::vector<llvm::Function *> &functions;
+  llvm::Module &module;
+  LLVMContext &context;
+  IRBuilder<> Builder;
+  std::vector<Value *> registers;
+  std::map<int32_t, BasicBlock *> blocks;
+  llvm::Function *current;
+
+  llvm::Type *int_type() { return Builder.getInt32Ty(); }
+  llvm::Type *word_type() { return Builder.getInt64Ty(); }
+  llvm::Type *string_type() { return Builder.getInt8PtrTy(); }
+
+  BasicBlock *block_at(int32_t pc) {
+    BasicBlock *&block = blocks[pc];
+    if (!block)
+      block = BasicBlock::Create(context, "L" + std::to_string(pc), current);
+    return block;
+  }
+
+  Value *load(int32_t r) { return Builder.CreateLoad(word_type(), registers[r]); }
+  void store(int32_t r, Value *v) { Builder.CreateStore(v, registers[r]); }
+  Value *int_of(int32_t r) { return Builder.CreateTrunc(load(r), int_type()); }
+  Value *string_of(int32_t r) {
+    return Builder.CreateIntToPtr(load(r), string_type());
+  }
+  void set_int(int32_t r, Value *v) {
+    store(r, Builder.CreateSExt(v, word_type()));
+  }
+  void set_bool(int32_t r, Value *v) {
+    store(r, Builder.CreateZExt(v, word_type()));
+  }
+
+  llvm::Type *primitive_type(char kind) {
+    switch (kind) {
+    case 'i':
+      return int_type();
+    case 's':
+      return string_type();
+    default:
+      return Builder.getVoidTy();
+    }
+  }
+
+  llvm::Function *runtime(const std::string &name, const char *signature) {
+    if (llvm::Function *f = module.getFunction(name))
+      return f;
+    std::vector<llvm::Type *> params;
+    for (const char *p = signature + 1; *p; p++)
+      params.push_back(primitive_type(*p));
+    return llvm::Function::Create(
+        FunctionType::get(primitive_type(signature[0]), params, false),
+        GlobalValue::ExternalLinkage, name, &module);
+  }
+
+  void translate(const int32_t *pc, int32_t next);
+
+public:
+  Translator(const Program &program,
+             const std::vector<llvm::Function *> &functions,
+             llvm::Module &module)
+      : program(program), functions(functions), module(module),
+        context(module.getContext()), Builder(context) {}
+
+  void translate_function(int32_t id);
+};
+
+void Translator::translate_function(int32_t id) {
+  const Function &function = program.functions[id];
+  const int32_t begin = function.entry, end = function_end(program, id);
+  const int32_t *const code = program.code.data();
+  current = functions[id];
+  blocks.clear();
+
+  Builder.SetInsertPoint(BasicBlock::Create(context, "entry", current));
+  registers.assign(function.frame_size, nullptr);
+  for (int32_t r = 0; r < function.frame_size; r++)
+    registers[r] =
+        Builder.CreateAlloca(word_type(), nullptr, "r" + std::to_string(r));
+  int32_t r = 1;
+  for (Argument &arg : current->args())
+    store(r++, &arg);
+  Builder.CreateBr(block_at(begin));
+
+  // A basic block starts at every jump target and after every jump.
+  for (int32_t pc = begin; pc < end; pc += 1 + operand_count[code[pc]]) {
+    const Opcode op = Opcode(code[pc]);
+    const char *kinds = operand_kinds[op];
+    for (unsigned i = 0; kinds[i]; i++)
+      if (kinds[i] == 't')
+        block_at(code[pc + 1 + i]);
+    const int32_t next = pc + 1 + operand_count[op];
+    if ((op >= op_JMP && op <= op_FORLOOP) || op == op_RET || op == op_RETV)
+      if (next < end)
+        block_at(next);
+  }
+
+  for (int32_t pc = begin; pc < end; pc += 1 + operand_count[code[pc]]) {
+    BasicBlock *const insert = Builder.GetInsertBlock();
+    auto block = blocks.find(pc);
+    if (block != blocks.end()) {
+      if (!insert->getTerminator())
+        Builder.CreateBr(block->second);
+      Builder.SetInsertPoint(block->second);
+    } else if (insert->getTerminator()) {
+      // Unreachable code following a jump.
+      Builder.SetInsertPoint(BasicBlock::Create(context, "dead", current));
+    }
+    translate(code + pc, pc + 1 + operand_count[code[pc]]);
+  }
+  if (!Builder.GetInsertBlock()->getTerminator())
+    Builder.CreateUnreachable();
+}
+
+void Translator::translate(const int32_t *pc, int32_t next) {
+  switch (Opcode(pc[0])) {
+  case op_LOADI:
+    store(pc[1], Builder.getInt64(pc[2]));
+    break;
+  case op_LOADS:
+    store(pc[1], Builder.getInt64(
+                     reinterpret_cast<uint64_t>(program.string(pc[2]))));
+    break;
+  case op_MOVE:
+    store(pc[1], load(pc[2]));
+    break;
+  case op_GETUP:
+  case op_SETUP:
+  case op_LINK:
+    // Closed functions do not use static links.
+    break;
+  case op_ADD:
+    set_int(pc[1], Builder.CreateAdd(int_of(pc[2]), int_of(pc[3])));
+    break;
+  case op_ADDI:
+    set_int(pc[1], Builder.CreateAdd(int_of(pc[2]), Builder.getInt32(pc[3])));
+    break;
+  case op_SUB:
+    set_int(pc[1], Builder.CreateSub(int_of(pc[2]), int_of(pc[3])));
+    break;
+  case op_MUL:
+    set_int(pc[1], Builder.CreateMul(int_of(pc[2]), int_of(pc[3])));
+    break;
+  case op_DIV: {
+    Value *const a = int_of(pc[2]), *const b = int_of(pc[3]);
+    BasicBlock *const error = BasicBlock::Create(context, "div_zero", current);
+    BasicBlock *const ok = BasicBlock::Create(context, "div", current);
+    Builder.CreateCondBr(Builder.CreateICmpEQ(b, Builder.getInt32(0)), error,
+                         ok);
+    Builder.SetInsertPoint(error);
+    llvm::Type *const handler_type =
+        FunctionType::get(Builder.getVoidTy(), false)->getPointerTo();
+    Builder.CreateCall(
+        FunctionType::get(Builder.getVoidTy(), false),
+        Builder.CreateIntToPtr(
+            Builder.getInt64(reinterpret_cast<uint64_t>(&division_by_zero)),
+            handler_type));
+    Builder.CreateUnreachable();
+    Builder.SetInsertPoint(ok);
+    // Dividing in 64 bits makes the minimum integer divided by -1 wrap
+    // around instead of trapping, as in the interpreter.
+    Value *const quotient =
+        Builder.CreateSDiv(Builder.CreateSExt(a, word_type()),
+                           Builder.CreateSExt(b, word_type()));
+    set_int(pc[1], Builder.CreateTrunc(quotient, int_type()));
+    break;
+  }
+  case op_EQ:
+    set_bool(pc[1], Builder.CreateICmpEQ(int_of(pc[2]), int_of(pc[3])));
+    break;
+  case op_NE:
+    set_bool(pc[1], Builder.CreateICmpNE(int_of(pc[2]), int_of(pc[3])));
+    break;
+  case op_LT:
+    set_bool(pc[1], Builder.CreateICmpSLT(int_of(pc[2]), int_of(pc[3])));
+    break;
+  case op_LE:
+    set_bool(pc[1], Builder.CreateICmpSLE(int_of(pc[2]), int_of(pc[3])));
+    break;
+  case op_GT:
+    set_bool(pc[1], Builder.CreateICmpSGT(int_of(pc[2]), int_of(pc[3])));
+    break;
+  case op_GE:
+    set_bool(pc[1], Builder.CreateICmpSGE(int_of(pc[2]), int_of(pc[3])));
+    break;
+  case op_STREQ:
+  case op_STRNE: {
+    Value *const equal =
+        Builder.CreateCall(runtime("__streq", primitive_signatures[p_streq]),
+                           {string_of(pc[2]), string_of(pc[3])});
+    Value *const zero = Builder.getInt32(0);
+    set_bool(pc[1], pc[0] == op_STREQ ? Builder.CreateICmpNE(equal, zero)
+                                      : Builder.CreateICmpEQ(equal, zero));
+    break;
+  }
+  case op_STRLT:
+  case op_STRLE:
+  case op_STRGT:
+  case op_STRGE: {
+    static const CmpInst::Predicate predicates[] = {
+        CmpInst::ICMP_SLT, CmpInst::ICMP_SLE, CmpInst::ICMP_SGT,
+        CmpInst::ICMP_SGE};
+    Value *const order =
+        Builder.CreateCall(runtime("__strcmp", primitive_signatures[p_strcmp]),
+                           {string_of(pc[2]), string_of(pc[3])});
+    set_bool(pc[1], Builder.CreateICmp(predicates[pc[0] - op_STRLT], order,
+                                       Builder.getInt32(0)));
+    break;
+  }
+  case op_JMP:
+    Builder.CreateBr(block_at(pc[1]));
+    break;
+  case op_JZ:
+  case op_JNZ: {
+    Value *const zero =
+        Builder.CreateICmpEQ(int_of(pc[1]), Builder.getInt32(0));
+    Builder.CreateCondBr(pc[0] == op_JZ ? zero : Builder.CreateNot(zero),
+                         block_at(pc[2]), block_at(next));
+    break;
+  }
+  case op_JEQ:
+  case op_JNE:
+  case op_JLT:
+  case op_JLE:
+  case op_JGT:
+  case op_JGE: {
+    static const CmpInst::Predicate predicates[] = {
+        CmpInst::ICMP_EQ,  CmpInst::ICMP_NE,  CmpInst::ICMP_SLT,
+        CmpInst::ICMP_SLE, CmpInst::ICMP_SGT, CmpInst::ICMP_SGE};
+    Builder.CreateCondBr(Builder.CreateICmp(predicates[pc[0] - op_JEQ],
+                                            int_of(pc[1]), int_of(pc[2])),
+                         block_at(pc[3]), block_at(next));
+    break;
+  }
+  case op_FORLOOP: {
+    Value *const index = int_of(pc[1]);
+    BasicBlock *const loop = BasicBlock::Create(context, "loop", current);
+    Builder.CreateCondBr(Builder.CreateICmpSLT(index, int_of(pc[2])), loop,
+                         block_at(next));
+    Builder.SetInsertPoint(loop);
+    set_int(pc[1], Builder.CreateAdd(index, Builder.getInt32(1)));
+    Builder.CreateBr(block_at(pc[3]));
+    break;
+  }
+  case op_CALL: {
+    llvm::Function *const callee = functions[pc[1]];
+    std::vector<Value *> args;
+    for (int32_t i = 0; i < program.functions[pc[1]].params; i++)
+      args.push_back(load(pc[2] + 1 + i));
+    store(pc[2], Builder.CreateCall(callee, args));
+    break;
+  }
+  case op_PRIM: {
+    const Primitive primitive = Primitive(pc[2]);
+    if (primitive == p_lnot) {
+      set_bool(pc[1], Builder.CreateICmpEQ(int_of(pc[3]), Builder.getInt32(0)));
+      break;
+    }
+    const char *const signature = primitive_signatures[primitive];
+    static const char *const names[] = {
+#define VM_PRIMITIVE_NAME(name, tiger_name, signature) "__" tiger_name,
+        VM_PRIMITIVES(VM_PRIMITIVE_NAME)
+#undef VM_PRIMITIVE_NAME
+    };
+    std::vector<Value *> args;
+    for (unsigned i = 1; signature[i]; i++)
+      args.push_back(signature[i] == 'i' ? int_of(pc[2 + i])
+                                         : string_of(pc[2 + i]));
+    Value *const result =
+        Builder.CreateCall(runtime(names[primitive], signature), args);
+    if (signature[0] == 'i')
+      set_int(pc[1], result);
+    else if (signature[0] == 's')
+      store(pc[1], Builder.CreatePtrToInt(result, word_type()));
+    break;
+  }
+  case op_RET:
+    Builder.CreateRet(load(pc[1]));
+    break;
+  case op_RETV:
+    Builder.CreateRet(Builder.getInt64(0));
+    break;
+  }
+}
+
+} // namespace
+
+NativeTier::NativeTier(const Program &program)
+    : program(program), closed(program.functions.size(), true),
+      requested(program.functions.size(), false),
+      invalid(program.functions.size(), false),
+      natives(new std::atomic<NativeFunction>[program.functions.size()]) {
+  const size_t count = program.functions.size();
+  const int32_t *const code = program.code.data();
+  std::vector<std::vector<int32_t>> callees(count);
+  for (size_t id = 0; id < count; id++) {
+    natives[id].store(nullptr, std::memory_order_relaxed);
+    for (int32_t pc = program.functions[id].entry,
+                 end = function_end(program, id);
+         pc < end; pc += 1 + operand_count[code[pc]]) {
+      if (code[pc] == op_GETUP || code[pc] == op_SETUP)
+        closed[id] = false;
+      else if (code[pc] == op_CALL)
+        callees[id].push_back(code[pc + 1]);
+    }
+  }
+  // A function calling a function which is not closed is not closed
+  // either.
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t id = 0; id < count; id++)
+      if (closed[id])
+        for (int32_t callee : callees[id])
+          if (!closed[callee]) {
+            closed[id] = false;
+            changed = true;
+            break;
+          }
+  }
+  worker = std::thread(&NativeTier::work, this);
+}
+
+NativeTier::~NativeTier() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_one();
+  worker.join();
+}
+
+void NativeTier::request(int32_t id) {
+  if (!closed[id] || requested[id])
+    return;
+  requested[id] = true;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    queue.push_back(id);
+  }
+  wake.notify_one();
+}
+
+void NativeTier::work() {
+  for (;;) {
+    int32_t id;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      wake.wait(guard, [this] { return stopping || !queue.empty(); });
+      if (stopping)
+        return;
+      id = queue.front();
+      queue.pop_front();
+    }
+    if (!native(id))
+      compile(id);
+  }
+}
+
+// Compile a function along with all the functions it may call, which
+// are closed as well, into a new module.
+void NativeTier::compile(int32_t id) {
+  const int32_t *const code = program.code.data();
+  std::vector<int32_t> members{id};
+  std::vector<bool> included(program.functions.size(), false);
+  included[id] = true;
+  for (size_t i = 0; i < members.size(); i++)
+    for (int32_t pc = program.functions[members[i]].entry,
+                 end = function_end(program, members[i]);
+         pc < end; pc += 1 + operand_count[code[pc]])
+      if (code[pc] == op_CALL && !included[code[pc + 1]]) {
+        included[code[pc + 1]] = true;
+        members.push_back(code[pc + 1]);
+      }
+  for (int32_t member : members)
+    if (invalid[member])
+      return;
+
+  std::unique_ptr<Module> compiled(new Module);
+  compiled->context.reset(new LLVMContext);
+  LLVMContext &context = *compiled->context;
+  std::unique_ptr<llvm::Module> module(
+      new llvm::Module(program.functions[id].name, context));
+  module->setTargetTriple(sys::getProcessTriple());
+
+  llvm::Type *const word = llvm::Type::getInt64Ty(context);
+  std::vector<llvm::Function *> functions(program.functions.size(), nullptr);
+  for (int32_t member : members) {
+    const Function &function = program.functions[member];
+    functions[member] = llvm::Function::Create(
+        FunctionType::get(word, std::vector<llvm::Type *>(function.params, word),
+                          false),
+        GlobalValue::InternalLinkage, function.name, module.get());
+  }
+
+  Translator translator(program, functions, *module);
+  IRBuilder<> Builder(context);
+  for (int32_t member : members) {
+    translator.translate_function(member);
+
+    // The entry point called by the interpreter takes the arguments
+    // from its registers.
+    llvm::Function *const entry = llvm::Function::Create(
+        FunctionType::get(word, {word->getPointerTo()}, false),
+        GlobalValue::ExternalLinkage, entry_name(program.functions[member]),
+        module.get());
+    Builder.SetInsertPoint(BasicBlock::Create(context, "entry", entry));
+    Value *const args = &*entry->arg_begin();
+    std::vector<Value *> values;
+    for (int32_t i = 0; i < program.functions[member].params; i++)
+      values.push_back(Builder.CreateLoad(
+          word, Builder.CreateInBoundsGEP(word, args, Builder.getInt64(i))));
+    Builder.CreateRet(Builder.CreateCall(functions[member], values));
+  }
+
+  // The functions of an invalid module are left to the interpreter,
+  // since exiting from the worker would race with the running program.
+  if (verifyModule(*module, &errs())) {
+    errs() << "invalid module generated for " << program.functions[id].name
+           << ", interpreting it instead\n";
+    for (int32_t member : members)
+      invalid[member] = true;
+    return;
+  }
+  backend::optimize(*module, 2);
+  compiled->engine = backend::create_engine(std::move(module));
+
+  for (int32_t member : members)
+    if (!native(member)) {
+      auto const address = compiled->engine->getFunctionAddress(
+          entry_name(program.functions[member]));
+      natives[member].store(reinterpret_cast<NativeFunction>(address),
+                            std::memory_order_release);
+    }
+  modules.push_back(std::move(compiled));
+}
+
+} // namespace vm
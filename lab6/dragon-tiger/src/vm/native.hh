@@ -0,0 +1,68 @@
+#ifndef NATIVE_HH
+#define NATIVE_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bytecode.hh"
+
+namespace vm {
+
+// Native code of a function, called with a pointer to its arguments.
+typedef int64_t (*NativeFunction)(const int64_t *args);
+
+// NativeTier compiles the functions that the interpreter finds hot to
+// native code with LLVM. Compilation happens on a background thread
+// while the interpreter keeps running the bytecode, and the native code
+// is used by the calls which happen once it is ready.
+//
+// Only closed functions are compiled: those which do not access the
+// variables of enclosing functions and only call closed functions.
+// They do not need static links, so their registers become SSA values
+// and they call each other directly.
+class NativeTier {
+  struct Module;
+
+  const Program &program;
+  std::vector<bool> closed;
+  std::vector<bool> requested;
+  // Functions which were part of a module that failed to verify. They
+  // are never compiled again. Only the worker uses this.
+  std::vector<bool> invalid;
+  std::unique_ptr<std::atomic<NativeFunction>[]> natives;
+  // Modules compiled by the worker, which must live as long as their
+  // code may run.
+  std::vector<std::unique_ptr<Module>> modules;
+
+  std::mutex lock;
+  std::condition_variable wake;
+  std::deque<int32_t> queue;
+  bool stopping = false;
+  std::thread worker;
+
+  void work();
+  void compile(int32_t id);
+
+public:
+  explicit NativeTier(const Program &);
+  ~NativeTier();
+
+  // Return the native code of a function, or nullptr if there is none
+  // yet.
+  NativeFunction native(int32_t id) const {
+    return natives[id].load(std::memory_order_acquire);
+  }
+
+  // Queue a function for compilation, if it is closed and has not been
+  // requested before. This must be called from the interpreter thread.
+  void request(int32_t id);
+};
+
+} // namespace vm
+
+#endif // NATIVE_HH
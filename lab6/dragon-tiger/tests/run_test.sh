@@ -0,0 +1,15 @@
+#! /bin/sh
+#
+# Run a Tiger program in the bytecode VM of dtiger and compare its
+# output with the .expected file next to it. The program is run twice:
+# interpreted only, then with every function called more than once
+# compiled to native code.
+
+test $# -eq 1 || { echo "usage: $0 program.tig" >&2; exit 99; }
+expected="${1%.tig}.expected"
+status=0
+for threshold in 0 1; do
+  "${DTIGER:-dtiger}" --vm --jit-threshold $threshold "$1" |
+    diff -u "$expected" - || status=1
+done
+exit $status